@@ -1,50 +1,580 @@
 #include "hashtable.h"
 
-#define XXH_STATIC_LINKING_ONLY
-#define XXH_IMPLEMENTATION
+// guards against the implementation being pulled in twice when hashtable.h includes it
+#ifndef HASHTABLE_C_INCLUDED
+#define HASHTABLE_C_INCLUDED
+
+// xxhash is always inlined into the hashtable implementation so the hash call can be specialized
+#define XXH_INLINE_ALL
 #include "xxhash/xxhash.h"
 
-bool hashtable_init(Hashtable *ht, const size_t key_size, const size_t value_size, const unsigned int base_capacity) {
+#include <pthread.h>
+#include <stdatomic.h>
+
+#if defined(__GLIBC__)
+#include <malloc.h>
+#endif
+
+#ifdef HASHTABLE_HUGEPAGES
+#include <sys/mman.h>
+#endif
+
+#if defined(HASHTABLE_STATS) || defined(HASHTABLE_LATENCY) || defined(HASHTABLE_TRACE) || defined(HASHTABLE_USDT)
+#include <time.h>
+
+static inline uint64_t monotonic_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+#endif
+
+#ifdef HASHTABLE_STATS
+#define HT_STAT_ADD(ht, field, n) ((ht)->stats->field += (n))
+
+static inline void stats_record_probe(const Hashtable *ht, ht_index_t length) {
+    HTStats *stats = ht->stats;
+    stats->probe_total += length;
+    if (length > stats->probe_max) {
+        stats->probe_max = length;
+    }
+    stats->probe_hist[length > HT_STATS_PROBE_BUCKETS ? HT_STATS_PROBE_BUCKETS - 1 : length - 1]++;
+}
+#else
+// compiled out entirely, the arguments are not evaluated
+#define HT_STAT_ADD(ht, field, n) ((void)0)
+#define stats_record_probe(ht, length) ((void)0)
+#endif
+
+/**
+ * USDT static probes, provider "hashtable", compiled in with HASHTABLE_USDT when <sys/sdt.h> (systemtap-sdt-dev)
+ * is available. An unattached probe is a single nop, bpftrace/perf/stap attach to them without a rebuild, e.g.
+ *   bpftrace -e 'usdt:./app:hashtable:resize_end { @ns = hist(arg3); }'
+ *   resize_start(ht, old_capacity, desired_capacity, count)
+ *   resize_end(ht, new_capacity, ok, nanoseconds)
+ *   long_probe(ht, probe_length, capacity, count)  probe sequences longer than HASHTABLE_USDT_LONG_PROBE slots
+ *   alloc_fail(ht, bytes)  failed key/value or entry array allocations
+ * Without the flag (or the header) every probe compiles to nothing.
+ */
+#ifndef HASHTABLE_USDT_LONG_PROBE
+#define HASHTABLE_USDT_LONG_PROBE 16
+#endif
+
+#if defined(HASHTABLE_USDT) && defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define HT_USDT_ENABLED
+#endif
+#endif
+
+#ifdef HT_USDT_ENABLED
+#define HT_USDT2(name, a, b) DTRACE_PROBE2(hashtable, name, a, b)
+#define HT_USDT4(name, a, b, c, d) DTRACE_PROBE4(hashtable, name, a, b, c, d)
+#else
+#define HT_USDT2(name, a, b) ((void)0)
+#define HT_USDT4(name, a, b, c, d) ((void)0)
+#endif
+
+// every completed probe sequence of probe_free_idx/probe_used_idx is reported here
+#define record_probe_length(ht, length) do { \
+    stats_record_probe(ht, length); \
+    if ((length) > HASHTABLE_USDT_LONG_PROBE) { \
+        HT_USDT4(long_probe, (ht), (length), (ht)->capacity, (ht)->count); \
+    } \
+} while (0)
+
+#ifdef HASHTABLE_LATENCY
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+static inline uint64_t latency_ticks(void) {
+    return __rdtsc();
+}
+#elif defined(__aarch64__)
+static inline uint64_t latency_ticks(void) {
+    uint64_t ticks;
+    __asm__ volatile("mrs %0, cntvct_el0" : "=r"(ticks));
+    return ticks;
+}
+#else
+static inline uint64_t latency_ticks(void) {
+    return monotonic_ns();
+}
+#endif
+
+static inline unsigned int latency_bucket(uint64_t ticks) {
+    if (ticks < ((uint64_t)1 << HT_LATENCY_SUB_BITS)) {
+        return (unsigned int)ticks;
+    }
+    unsigned int msb = 63 - (unsigned int)__builtin_clzll(ticks);
+    unsigned int shift = msb - HT_LATENCY_SUB_BITS;
+    unsigned int sub = (unsigned int)(ticks >> shift) & ((1u << HT_LATENCY_SUB_BITS) - 1);
+    return ((shift + 1) << HT_LATENCY_SUB_BITS) + sub;
+}
+
+// largest value that falls into bucket
+static inline uint64_t latency_bucket_high(unsigned int bucket) {
+    if (bucket < (1u << HT_LATENCY_SUB_BITS)) {
+        return bucket;
+    }
+    unsigned int shift = (bucket >> HT_LATENCY_SUB_BITS) - 1;
+    uint64_t sub = bucket & ((1u << HT_LATENCY_SUB_BITS) - 1);
+    uint64_t low = (((uint64_t)1 << HT_LATENCY_SUB_BITS) | sub) << shift;
+    return low + (((uint64_t)1 << shift) - 1);
+}
+
+static inline void latency_record(const Hashtable *ht, HTLatencyOp op, uint64_t ticks) {
+    HTLatencyHistogram *hist = &ht->latency->ops[op];
+    hist->count++;
+    hist->total += ticks;
+    if (ticks > hist->max) {
+        hist->max = ticks;
+    }
+    hist->buckets[latency_bucket(ticks)]++;
+}
+
+#define LATENCY_BEGIN() uint64_t latency_start = latency_ticks()
+#define LATENCY_END(ht, op) latency_record(ht, op, latency_ticks() - latency_start)
+#else
+#define LATENCY_BEGIN() ((void)0)
+#define LATENCY_END(ht, op) ((void)0)
+#endif
+
+#ifdef HASHTABLE_TRACE
+typedef struct HTTrace {
+    FILE *file;
+    uint64_t last_ns;
+    bool hashed_keys;
+} HTTrace;
+
+static void trace_u32(FILE *file, uint32_t x) {
+    for (int i = 0; i < 4; i++) {
+        fputc((int)((x >> (8 * i)) & 0xFF), file);
+    }
+}
+
+static void trace_varint(FILE *file, uint64_t x) {
+    while (x >= 0x80) {
+        fputc((int)((x & 0x7F) | 0x80), file);
+        x >>= 7;
+    }
+    fputc((int)x, file);
+}
+
+// writes the op byte and timestamp delta, plus the key for put/find/remove and the capacity for resize
+static void trace_record(const Hashtable *ht, HTTraceOp op, const void *key, ht_index_t capacity) {
+    HTTrace *trace = ht->trace;
+    uint64_t now = monotonic_ns();
+    fputc((int)op, trace->file);
+    trace_varint(trace->file, now - trace->last_ns);
+    trace->last_ns = now;
+    if (key && trace->hashed_keys) {
+        uint64_t hash = XXH64(key, ht->key_size, 0);
+        for (int i = 0; i < 8; i++) {
+            fputc((int)((hash >> (8 * i)) & 0xFF), trace->file);
+        }
+    } else if (key) {
+        fwrite(key, 1, ht->key_size, trace->file);
+    } else if (op == HT_TRACE_RESIZE) {
+        trace_varint(trace->file, capacity);
+    }
+}
+
+#define TRACE_RECORD(ht, op, key, capacity) do { \
+    if ((ht)->trace) trace_record(ht, op, key, capacity); \
+} while (0)
+#else
+#define TRACE_RECORD(ht, op, key, capacity) ((void)0)
+#endif
+
+// words of the occupancy bitmap needed for capacity slots
+static inline size_t used_bits_words(ht_index_t capacity) {
+    return ((size_t)capacity + 63) / 64;
+}
+
+static inline void used_bits_set(Hashtable *ht, ht_index_t idx) {
+    ht->used_bits[idx / 64] |= (uint64_t)1 << (idx % 64);
+}
+
+static inline void used_bits_clear(Hashtable *ht, ht_index_t idx) {
+    ht->used_bits[idx / 64] &= ~((uint64_t)1 << (idx % 64));
+}
+
+static inline unsigned int ctz64(uint64_t word) {
+#if defined(__GNUC__) || defined(__clang__)
+    return (unsigned int)__builtin_ctzll(word);
+#else
+    unsigned int n = 0;
+    while (!(word & 1)) {
+        word >>= 1;
+        n++;
+    }
+    return n;
+#endif
+}
+
+static void *default_alloc(void *ctx, size_t size) {
+    (void)ctx;
+    return malloc(size);
+}
+
+static void *default_realloc(void *ctx, void *ptr, size_t old_size, size_t new_size) {
+    (void)ctx;
+    (void)old_size;
+    return realloc(ptr, new_size);
+}
+
+static void default_free(void *ctx, void *ptr, size_t size) {
+    (void)ctx;
+    (void)size;
+    free(ptr);
+}
+
+static inline void *ht_alloc(const Hashtable *ht, size_t size) {
+    return ht->allocator.alloc(ht->allocator.ctx, size);
+}
+
+static inline void ht_free(const Hashtable *ht, void *ptr, size_t size) {
+    ht->allocator.free(ht->allocator.ctx, ptr, size);
+}
+
+static inline void *ht_realloc(const Hashtable *ht, void *ptr, size_t old_size, size_t new_size) {
+    return ht->allocator.realloc(ht->allocator.ctx, ptr, old_size, new_size);
+}
+
+static inline void *ht_alloc_zeroed(const Hashtable *ht, size_t size) {
+    void *ptr = ht_alloc(ht, size);
+    if (ptr) {
+        memset(ptr, 0, size);
+    }
+    return ptr;
+}
+
+// size class of a slab block, the free list link needs at least 8 bytes
+static inline size_t slab_block_size(size_t size) {
+    return size <= 8 ? 8 : (size + 15) & ~(size_t)15;
+}
+
+#define SLAB_CLASSES (HT_SLAB_MAX_BLOCK / 16 + 1) // class 0 holds 8 byte blocks, class i blocks of 16 * i bytes
+
+typedef struct SlabChunk {
+    struct SlabChunk *next;
+    size_t size;
+} SlabChunk;
+
+struct HTSlabArena {
+    void *free_lists[SLAB_CLASSES]; // freed blocks linked through their first word
+    unsigned char *bump; // next uncarved byte of the newest chunk
+    unsigned char *bump_end;
+    SlabChunk *chunks;
+    size_t next_chunk_size;
+    size_t reserved;
+};
+
+static void *slab_alloc(void *ctx, size_t size) {
+    HTSlabArena *arena = (HTSlabArena *)ctx;
+    if (size > HT_SLAB_MAX_BLOCK) {
+        return malloc(size);
+    }
+    size_t block = slab_block_size(size);
+    size_t cls = block / 16;
+    void *ptr = arena->free_lists[cls];
+    if (ptr) {
+        memcpy(&arena->free_lists[cls], ptr, sizeof(void *));
+        return ptr;
+    }
+    size_t align = block == 8 ? 8 : 16;
+    unsigned char *start = (unsigned char *)(((uintptr_t)arena->bump + align - 1) & ~(uintptr_t)(align - 1));
+    if (!arena->bump || start + block > arena->bump_end) {
+        // a new chunk, sizes double so a table of n entries needs O(log n) chunks and O(n / HT_SLAB_MAX_CHUNK) at most
+        size_t chunk_size = arena->next_chunk_size;
+        SlabChunk *chunk = (SlabChunk *)malloc(chunk_size);
+        if (!chunk) {
+            return NULL;
+        }
+        chunk->next = arena->chunks;
+        chunk->size = chunk_size;
+        arena->chunks = chunk;
+        arena->reserved += chunk_size;
+        arena->bump = (unsigned char *)chunk + ((sizeof(SlabChunk) + 15) & ~(size_t)15);
+        arena->bump_end = (unsigned char *)chunk + chunk_size;
+        if (arena->next_chunk_size < HT_SLAB_MAX_CHUNK) {
+            arena->next_chunk_size *= 2;
+        }
+        start = arena->bump;
+    }
+    arena->bump = start + block;
+    return start;
+}
+
+static void slab_free(void *ctx, void *ptr, size_t size) {
+    HTSlabArena *arena = (HTSlabArena *)ctx;
+    if (!ptr) {
+        return;
+    }
+    if (size > HT_SLAB_MAX_BLOCK) {
+        free(ptr);
+        return;
+    }
+    size_t cls = slab_block_size(size) / 16;
+    memcpy(ptr, &arena->free_lists[cls], sizeof(void *));
+    arena->free_lists[cls] = ptr;
+}
+
+static void *slab_realloc(void *ctx, void *ptr, size_t old_size, size_t new_size) {
+    if (old_size > HT_SLAB_MAX_BLOCK && new_size > HT_SLAB_MAX_BLOCK) {
+        return realloc(ptr, new_size);
+    }
+    if (ptr && old_size <= HT_SLAB_MAX_BLOCK && new_size <= HT_SLAB_MAX_BLOCK &&
+        slab_block_size(old_size) == slab_block_size(new_size)) {
+        return ptr;
+    }
+    void *moved = slab_alloc(ctx, new_size);
+    if (moved && ptr) {
+        memcpy(moved, ptr, old_size < new_size ? old_size : new_size);
+        slab_free(ctx, ptr, old_size);
+    }
+    return moved;
+}
+
+HASHTABLE_API HTSlabArena *hashtable_slab_arena_create(void) {
+    HTSlabArena *arena = (HTSlabArena *)calloc(1, sizeof(HTSlabArena));
+    if (!arena) {
+        fprintf(stderr, "failed to allocate slab arena\n");
+        return NULL;
+    }
+    arena->next_chunk_size = HT_SLAB_MIN_CHUNK;
+    return arena;
+}
+
+HASHTABLE_API void hashtable_slab_arena_destroy(HTSlabArena *arena) {
+    if (!arena) {
+        return;
+    }
+    while (arena->chunks) {
+        SlabChunk *next = arena->chunks->next;
+        free(arena->chunks);
+        arena->chunks = next;
+    }
+    free(arena);
+}
+
+HASHTABLE_API HTAllocator hashtable_slab_allocator(HTSlabArena *arena) {
+    HTAllocator allocator = {slab_alloc, slab_realloc, slab_free, arena, HT_ALLOCATOR_SLAB};
+    return allocator;
+}
+
+HASHTABLE_API size_t hashtable_slab_arena_reserved(const HTSlabArena *arena) {
+    return arena ? arena->reserved : 0;
+}
+
+#ifdef HASHTABLE_HUGEPAGES
+#define HUGE_PAGE_BYTES ((size_t)2 * 1024 * 1024)
+
+static inline size_t huge_page_round(size_t size) {
+    return (size + HUGE_PAGE_BYTES - 1) & ~(HUGE_PAGE_BYTES - 1);
+}
+
+HASHTABLE_API void *hashtable_huge_alloc(size_t size) {
+    size_t bytes = huge_page_round(size);
+#ifdef MAP_HUGETLB
+    int hugetlb_flags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB;
+#ifdef MAP_HUGE_2MB
+    hugetlb_flags |= MAP_HUGE_2MB; // the default hugetlb size may be 1GB
+#endif
+    void *ptr = mmap(NULL, bytes, PROT_READ | PROT_WRITE, hugetlb_flags, -1, 0);
+    if (ptr != MAP_FAILED) {
+        return ptr;
+    }
+#endif
+    // no reserved huge pages, over map by a page and trim so the range can be backed by transparent huge pages
+    unsigned char *raw = (unsigned char *)mmap(NULL, bytes + HUGE_PAGE_BYTES, PROT_READ | PROT_WRITE,
+                                               MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (raw == MAP_FAILED) {
+        return NULL;
+    }
+    unsigned char *aligned = (unsigned char *)(((uintptr_t)raw + HUGE_PAGE_BYTES - 1) & ~(uintptr_t)(HUGE_PAGE_BYTES - 1));
+    size_t head = (size_t)(aligned - raw);
+    if (head > 0) {
+        munmap(raw, head);
+    }
+    munmap(aligned + bytes, HUGE_PAGE_BYTES - head);
+#ifdef MADV_HUGEPAGE
+    madvise(aligned, bytes, MADV_HUGEPAGE); // best effort, fails when THP is disabled
+#endif
+    return aligned;
+}
+
+HASHTABLE_API void hashtable_huge_free(void *ptr, size_t size) {
+    if (ptr) {
+        munmap(ptr, huge_page_round(size));
+    }
+}
+#endif
+
+// entry arrays of large tables are mapped on huge pages unless the table has a custom allocator,
+// the choice only depends on the size so frees take the same path as the allocation
+static inline bool entries_on_huge_pages(const Hashtable *ht, size_t bytes) {
+#ifdef HASHTABLE_HUGEPAGES
+    return bytes >= HT_HUGEPAGE_MIN_BYTES && ht->allocator.kind != HT_ALLOCATOR_USER;
+#else
+    (void)ht;
+    (void)bytes;
+    return false;
+#endif
+}
+
+static Hashentry *alloc_entries(const Hashtable *ht, ht_index_t capacity) {
+    if (capacity > SIZE_MAX / sizeof(Hashentry)) {
+        return NULL;
+    }
+    size_t bytes = capacity * sizeof(Hashentry);
+#ifdef HASHTABLE_HUGEPAGES
+    if (entries_on_huge_pages(ht, bytes)) {
+        return (Hashentry *)hashtable_huge_alloc(bytes);
+    }
+#endif
+    return (Hashentry *)ht_alloc(ht, bytes);
+}
+
+static void free_entries(const Hashtable *ht, Hashentry *arr, ht_index_t capacity) {
+    size_t bytes = capacity * sizeof(Hashentry);
+#ifdef HASHTABLE_HUGEPAGES
+    if (entries_on_huge_pages(ht, bytes)) {
+        hashtable_huge_free(arr, bytes);
+        return;
+    }
+#endif
+    ht_free(ht, arr, bytes);
+}
+
+static ht_index_t strategy_capacity(HTProbeStrategy strategy, ht_index_t desired);
+
+HASHTABLE_API bool hashtable_init(Hashtable *ht, const size_t key_size, const size_t value_size, const ht_index_t base_capacity) {
+    return hashtable_init_with_allocator(ht, key_size, value_size, base_capacity, NULL);
+}
+
+HASHTABLE_API bool hashtable_init_arena(Hashtable *ht, const size_t key_size, const size_t value_size, const ht_index_t base_capacity) {
+    HTSlabArena *arena = hashtable_slab_arena_create();
+    if (!arena) {
+        return false;
+    }
+    HTAllocator allocator = hashtable_slab_allocator(arena);
+    if (!hashtable_init_with_allocator(ht, key_size, value_size, base_capacity, &allocator)) {
+        hashtable_slab_arena_destroy(arena);
+        return false;
+    }
+    ht->arena = arena;
+    return true;
+}
+
+HASHTABLE_API bool hashtable_init_with_allocator(Hashtable *ht, const size_t key_size, const size_t value_size,
+                                                 const ht_index_t base_capacity, const HTAllocator *allocator) {
     if (!ht) {
         fprintf(stderr, "Hashtable is NULL, unable to initialize.\n");
         return false;
     }
-    if (key_size < 1 || value_size < 1 || base_capacity < 1) {
-        fprintf(stderr, "To use hashtable_init both the value_size for the type, and capacity must be positive\n");
+    // a value_size of 0 is a set, no value storage is allocated for entries
+    if (key_size < 1 || base_capacity < 1) {
+        fprintf(stderr, "To use hashtable_init both the key_size for the type, and capacity must be positive\n");
         return false;
     }
     ht->count = 0;
-    ht->capacity = base_capacity;
+    ht->tombstones = 0;
+    ht->probe = HT_PROBE_DEFAULT;
+    // linear probing covers any capacity, for the others the sequence would never visit some slots
+    ht->capacity = ht->probe == HT_PROBE_LINEAR ? base_capacity : strategy_capacity(ht->probe, base_capacity);
+    if (ht->capacity == 0) {
+        fprintf(stderr, "hashtable_init capacity exceeds the index limit\n");
+        return false;
+    }
     ht->key_size = key_size;
     ht->value_size = value_size; // size of the stored elements themselves in bytes not the Hashentries
-    ht->arr = (Hashentry *)malloc(ht->capacity * sizeof(Hashentry));
-    if (!ht->arr) {
+    ht->multimap = false;
+    ht->hash_kind = HT_HASH_XXH64;
+    ht->hash_func = NULL;
+    if (allocator) {
+        ht->allocator = *allocator;
+    } else {
+        HTAllocator default_allocator = {default_alloc, default_realloc, default_free, NULL, HT_ALLOCATOR_DEFAULT};
+        ht->allocator = default_allocator;
+    }
+    ht->arena = NULL;
+    ht->arr = alloc_entries(ht, ht->capacity);
+    ht->used_bits = (uint64_t *)ht_alloc_zeroed(ht, used_bits_words(ht->capacity) * sizeof(uint64_t));
+#ifdef HASHTABLE_STATS
+    ht->stats = (HTStats *)calloc(1, sizeof(HTStats));
+    if (!ht->stats) { // fail through the check below
+        free_entries(ht, ht->arr, ht->capacity);
+        ht->arr = NULL;
+    }
+#endif
+#ifdef HASHTABLE_LATENCY
+    ht->latency = (HTLatency *)calloc(1, sizeof(HTLatency));
+    if (!ht->latency) {
+        free_entries(ht, ht->arr, ht->capacity);
+        ht->arr = NULL;
+    }
+#endif
+#ifdef HASHTABLE_TRACE
+    ht->trace = NULL;
+#endif
+    if (!ht->arr || !ht->used_bits) {
         fprintf(stderr, "Unable to allocate memory for Hashtable entries");
+        free_entries(ht, ht->arr, ht->capacity);
+        ht_free(ht, ht->used_bits, used_bits_words(ht->capacity) * sizeof(uint64_t));
+        ht->arr = NULL;
+        ht->used_bits = NULL;
+#ifdef HASHTABLE_STATS
+        free(ht->stats);
+        ht->stats = NULL;
+#endif
+#ifdef HASHTABLE_LATENCY
+        free(ht->latency);
+        ht->latency = NULL;
+#endif
         return false;
     }
-    for (unsigned int i = 0; i < ht->capacity; i++) {
+    for (ht_index_t i = 0; i < ht->capacity; i++) {
         hashtable_init_entry(ht, i, ENTRY_UNUSED);
     }
     return true;
 }
 
-void hashtable_deinit(Hashtable *ht) {
+HASHTABLE_API void hashtable_deinit(Hashtable *ht) {
     if (!ht || !ht->arr) {
         return;
     }
-    for (unsigned int i = 0; i < ht->capacity; i++) {
+#ifdef HASHTABLE_TRACE
+    hashtable_trace_stop(ht);
+#endif
+    // an owned arena releases every key/value block at once below, unless they are too large for its size classes
+    // and were passed to malloc
+    bool arena_owns_blocks = ht->arena && ht->key_size <= HT_SLAB_MAX_BLOCK && ht->value_size <= HT_SLAB_MAX_BLOCK;
+    for (ht_index_t i = 0; !arena_owns_blocks && i < ht->capacity; i++) {
         if (ht->arr[i].state == ENTRY_USED || ht->arr[i].state == ENTRY_DELETED) {
-            free(ht->arr[i].key);
-            free(ht->arr[i].value);
+            ht_free(ht, ht->arr[i].key, ht->key_size);
+            ht_free(ht, ht->arr[i].value, ht->value_size);
             ht->arr[i].key = NULL;
             ht->arr[i].value = NULL;
         }
     }
-    free(ht->arr);
+    free_entries(ht, ht->arr, ht->capacity);
+    ht_free(ht, ht->used_bits, used_bits_words(ht->capacity) * sizeof(uint64_t));
     ht->arr = NULL;
+    ht->used_bits = NULL;
+    hashtable_slab_arena_destroy(ht->arena);
+    ht->arena = NULL;
+#ifdef HASHTABLE_STATS
+    free(ht->stats);
+    ht->stats = NULL;
+#endif
+#ifdef HASHTABLE_LATENCY
+    free(ht->latency);
+    ht->latency = NULL;
+#endif
 }
 
-struct Hashtable *_hashtable_create(size_t key_size, size_t value_size, unsigned int new_cap) {
+HASHTABLE_API struct Hashtable *_hashtable_create(size_t key_size, size_t value_size, ht_index_t new_cap) {
     Hashtable *ht = (Hashtable *)malloc(sizeof(Hashtable));
     if (!ht) {
         fprintf(stderr, "Failed to allocate memory for ht during hashtable_create\n");
@@ -58,7 +588,7 @@ struct Hashtable *_hashtable_create(size_t key_size, size_t value_size, unsigned
     return ht;
 }
 
-void _hashtable_destroy(Hashtable **ht_ptr) {
+HASHTABLE_API void _hashtable_destroy(Hashtable **ht_ptr) {
     if (ht_ptr && *ht_ptr)  {
         Hashtable *ht = *ht_ptr;
         hashtable_deinit(ht);
@@ -67,26 +597,138 @@ void _hashtable_destroy(Hashtable **ht_ptr) {
     }
 }
 
-uint64_t djb2(const void *key, size_t key_size) {
+HASHTABLE_API uint64_t djb2(const void *key, size_t key_size) {
    uint64_t hash = 5381;
-   const char *ptr = (char *)key;
-   const char *end = ptr + key_size;
-   for (int c = *ptr++; ptr < end; c = *ptr++) {
-       hash = ((hash << 5) + hash) + c; /* hash * 33 + c */
+   const unsigned char *ptr = (const unsigned char *)key;
+   const unsigned char *end = ptr + key_size;
+   while (ptr < end) {
+       hash = ((hash << 5) + hash) + *ptr++; /* hash * 33 + c */
    }
    return hash;
 }
 
-// unsigned long hash_func(const void *key, size_t key_size) {
-uint64_t hash_func(const void *key, size_t key_size) {
+static inline uint64_t hash_int(const void *key, size_t key_size) {
+    if (key_size == sizeof(uint32_t)) {
+        uint32_t x;
+        memcpy(&x, key, sizeof(x));
+        return hashtable_mix64(x);
+    }
+    if (key_size == sizeof(uint64_t)) {
+        uint64_t x;
+        memcpy(&x, key, sizeof(x));
+        return hashtable_mix64(x);
+    }
+    return XXH3_64bits(key, key_size);
+}
+
+HASHTABLE_API uint64_t hashtable_hash_xxh64(const void *key, size_t key_size) {
     return XXH64(key, key_size, 0);
-    // return djb2(key, key_size);
 }
 
-bool is_prime(unsigned int x) {
+HASHTABLE_API uint64_t hashtable_hash_xxh3(const void *key, size_t key_size) {
+    return XXH3_64bits(key, key_size);
+}
+
+HASHTABLE_API uint64_t hashtable_hash_int(const void *key, size_t key_size) {
+    return hash_int(key, key_size);
+}
+
+/**
+ * Hashes a key with the table's hash kind. A switch instead of always calling through ht->hash_func lets
+ * the built-in hashes inline here with the key size known at the call.
+ * home_idx uses the high bits of the hash, djb2 and custom callbacks are finalized with hashtable_mix64
+ * since they don't necessarily spread entropy into those bits.
+ */
+static inline uint64_t hash_func(const Hashtable *ht, const void *key) {
+    switch (ht->hash_kind) {
+    case HT_HASH_XXH3: return XXH3_64bits(key, ht->key_size);
+    case HT_HASH_INT: return hash_int(key, ht->key_size);
+    case HT_HASH_DJB2: return hashtable_mix64(djb2(key, ht->key_size));
+    case HT_HASH_CUSTOM: return hashtable_mix64(ht->hash_func(key, ht->key_size));
+    case HT_HASH_XXH64:
+    default: return XXH64(key, ht->key_size, 0);
+    }
+}
+
+// smallest hash whose home_idx is bucket, the inverse of home_idx for bucket < capacity
+static inline uint64_t bucket_first_hash(ht_index_t bucket, ht_index_t capacity) {
+#ifdef HT_HAVE_INT128
+    return (uint64_t)((((ht_uint128)bucket << 64) + capacity - 1) / capacity);
+#else
+    // ceil(bucket * 2^64 / capacity) by binary long division, bucket < capacity keeps the quotient in 64 bits
+    uint64_t quotient = 0;
+    uint64_t rem = bucket;
+    for (int bit = 0; bit < 64; bit++) {
+        uint64_t carry = rem >> 63;
+        rem <<= 1;
+        quotient <<= 1;
+        if (carry || rem >= capacity) {
+            rem -= capacity;
+            quotient |= 1;
+        }
+    }
+    return quotient + (rem != 0);
+#endif
+}
+
+#if defined(__GNUC__) || defined(__clang__)
+#define HT_ALWAYS_INLINE inline __attribute__((always_inline))
+#else
+#define HT_ALWAYS_INLINE inline
+#endif
+
+// double hashing step in [1, capacity - 1], every step is coprime to a prime capacity so the sequence visits
+// every slot. home_idx consumes the high bits of the hash, the step is taken from the low half.
+static inline ht_index_t double_hash_step(uint64_t hash, ht_index_t capacity) {
+    if (capacity < 2) {
+        return 1;
+    }
+    return 1 + home_idx((hash << 32) | (hash >> 32), capacity - 1);
+}
+
+// distance between consecutive probes of hash's sequence, computed once per walk (unused by quadratic probing)
+static HT_ALWAYS_INLINE ht_index_t probe_stride(HTProbeStrategy strategy, uint64_t hash, ht_index_t capacity) {
+    return strategy == HT_PROBE_DOUBLE ? double_hash_step(hash, capacity) : 1;
+}
+
+/**
+ * Slot of the x-th probe (x >= 1) of a sequence starting at start_idx, curr_idx being the (x-1)-th and stride
+ * coming from probe_stride. The hot probe loops pass a constant strategy so the branch folds away and each
+ * strategy gets its own loop, other walks go through probe_next_idx.
+ */
+static HT_ALWAYS_INLINE ht_index_t probe_step(const Hashtable *ht, HTProbeStrategy strategy, ht_index_t stride,
+                                              ht_index_t start_idx, ht_index_t curr_idx, ht_index_t x) {
+    if (strategy == HT_PROBE_QUADRATIC) {
+        return probe_idx_quadratic(start_idx, x, ht->capacity);
+    }
+    return probe_wrap_add(curr_idx, stride, ht->capacity);
+}
+
+// probe_step with the table's strategy, the first capacity probes visit every slot once
+static inline ht_index_t probe_next_idx(const Hashtable *ht, ht_index_t stride, ht_index_t start_idx, ht_index_t curr_idx, ht_index_t x) {
+    return probe_step(ht, ht->probe, stride, start_idx, curr_idx, x);
+}
+
+/**
+ * Returns the first ENTRY_UNUSED/ENTRY_DELETED slot along the probe sequence without comparing keys,
+ * used where the key is known to be absent (resize) or duplicates are allowed (multimap put).
+ */
+static ProbeResult probe_any_free_idx(const Hashtable *ht, uint64_t hash, const ht_index_t start_idx, ht_index_t *out_idx) {
+    const ht_index_t stride = probe_stride(ht->probe, hash, ht->capacity);
+    ht_index_t curr_idx = start_idx;
+    for (ht_index_t x = 0; x < ht->capacity; curr_idx = probe_next_idx(ht, stride, start_idx, curr_idx, ++x)) {
+        if (ht->arr[curr_idx].state != ENTRY_USED) {
+            *out_idx = curr_idx;
+            return PROBE_KEY_NOT_FOUND;
+        }
+    }
+    return PROBE_ERROR;
+}
+
+HASHTABLE_API bool is_prime(ht_index_t x) {
     if (x <= 1) return false;
     if (x == 2) return true;
-    for (unsigned int i = 3; (i * i < x); i += 2) {
+    for (ht_index_t i = 3; i <= x / i; i += 2) { // i * i would overflow for x near HT_INDEX_MAX
         if (x % i == 0) {
             return false;
         }
@@ -94,21 +736,44 @@ bool is_prime(unsigned int x) {
     return true;
 }
 
-unsigned int next_prime(unsigned int x) {
+HASHTABLE_API ht_index_t next_prime(ht_index_t x) {
     if (x <= 2) return 2;
-    if (is_even(x)) x++;
+    if (x % 2 == 0) x++;
     while (!is_prime(x)) {
+        if (x > HT_INDEX_MAX - 2) return 0;
         x += 2;
     }
     return x;
 }
 
-inline bool is_even(int x) {
+// smallest capacity >= desired that strategy's sequence fully covers, 0 when none fits
+static ht_index_t strategy_capacity(HTProbeStrategy strategy, ht_index_t desired) {
+    ht_index_t prime = next_prime(desired);
+    while (strategy == HT_PROBE_QUADRATIC && prime != 0 && prime % 4 != 3) {
+        prime = prime > HT_INDEX_MAX - 2 ? 0 : next_prime(prime + 2);
+    }
+    return prime;
+}
+
+HASHTABLE_API ht_index_t hashtable_probe_capacity(ht_index_t desired) {
+    return strategy_capacity(HT_PROBE_DEFAULT, desired);
+}
+
+HASHTABLE_API bool is_even(int x) {
     return x % 2 == 0;
 }
 
 
-bool hashtable_resize(Hashtable *ht, unsigned int desired_capacity) {
+static bool hashtable_rebuild(Hashtable *ht, ht_index_t desired_capacity);
+static bool resize_table(Hashtable *ht, ht_index_t desired_capacity);
+
+HASHTABLE_API bool hashtable_resize(Hashtable *ht, ht_index_t desired_capacity) {
+    TRACE_RECORD(ht, HT_TRACE_RESIZE, NULL, desired_capacity);
+    return resize_table(ht, desired_capacity);
+}
+
+// hashtable_resize without tracing, growth from hashtable_put isn't an API call of its own
+static bool resize_table(Hashtable *ht, ht_index_t desired_capacity) {
     if (desired_capacity < 2) {
         fprintf(stderr, "for hashtable_resize desired capacity must be >= 2\n");
         return false;
@@ -122,55 +787,96 @@ bool hashtable_resize(Hashtable *ht, unsigned int desired_capacity) {
             return false;
         }
     }
-    unsigned int old_cap = ht->capacity;
+#ifdef HT_USDT_ENABLED
+    uint64_t resize_start = monotonic_ns();
+#endif
+    HT_USDT4(resize_start, ht, ht->capacity, desired_capacity, ht->count);
+    LATENCY_BEGIN();
+    bool resized = hashtable_rebuild(ht, desired_capacity);
+    LATENCY_END(ht, HT_LATENCY_RESIZE);
+    HT_USDT4(resize_end, ht, ht->capacity, resized, monotonic_ns() - resize_start);
+    return resized;
+}
+
+// moves every ENTRY_USED entry into a fresh array of at least desired_capacity slots the table's probe strategy
+// fully covers, tombstones are dropped. Same size rebuilds of linear tables keep their capacity as is
+static bool hashtable_rebuild(Hashtable *ht, ht_index_t desired_capacity) {
+#ifdef HASHTABLE_STATS
+    uint64_t rebuild_start = monotonic_ns();
+#endif
+    ht_index_t old_cap = ht->capacity;
     Hashentry *old_arr = ht->arr;
+    uint64_t *old_used_bits = ht->used_bits;
 
-    unsigned int new_cap = next_prime(desired_capacity);
-    Hashentry *new_arr = (Hashentry *)malloc(sizeof(Hashentry) * new_cap);
-    if (!new_arr) {
+    // linear probing covers any capacity, only growth rounds up to a prime
+    bool keep_cap = ht->probe == HT_PROBE_LINEAR && desired_capacity == old_cap;
+    ht_index_t new_cap = keep_cap ? old_cap : strategy_capacity(ht->probe, desired_capacity);
+    if (new_cap == 0) {
+        fprintf(stderr, "hashtable capacity limit reached, build with HASHTABLE_64BIT_INDEX for larger tables\n");
+        return false;
+    }
+    Hashentry *new_arr = alloc_entries(ht, new_cap);
+    // the old bitmap isn't read while reinserting (that goes by entry state), so it is resized in place and cleared
+    size_t old_bits_size = used_bits_words(old_cap) * sizeof(uint64_t);
+    size_t new_bits_size = used_bits_words(new_cap) * sizeof(uint64_t);
+    uint64_t *new_used_bits = new_arr ? (uint64_t *)ht_realloc(ht, old_used_bits, old_bits_size, new_bits_size) : NULL;
+    if (!new_arr || !new_used_bits) {
+        HT_USDT2(alloc_fail, ht, sizeof(Hashentry) * new_cap);
         fprintf(stderr, "failed to allocate new larger internal \
             array for hashtable during resize\n");
+        free_entries(ht, new_arr, new_cap); // a failed realloc leaves the old bitmap as it was
         return false;
     }
+    memset(new_used_bits, 0, new_bits_size);
     ht->arr = new_arr;
+    ht->used_bits = new_used_bits;
     ht->capacity = new_cap;
-    for (unsigned int i = 0; i < new_cap; i++) {
+    for (ht_index_t i = 0; i < new_cap; i++) {
         // this is done so probing works correctly
         // it expects some ENTRY_STATE for each entry upfront 
         hashtable_init_entry(ht, i, ENTRY_UNUSED);
     }
+    ht->tombstones = 0;
 
-    for (unsigned int i = 0; i < old_cap; i++) {
+    for (ht_index_t i = 0; i < old_cap; i++) {
         Hashentry old_entry = old_arr[i];
         if (old_entry.state != ENTRY_USED) {
             continue;
         }
-        unsigned int new_start_idx = old_entry.stored_hash % ht->capacity;
-        unsigned int ret_idx;
-        ProbeResult res = probe_free_idx(ht, old_entry.key, old_entry.stored_hash, new_start_idx, &ret_idx);
+        ht_index_t new_start_idx = home_idx(old_entry.stored_hash, ht->capacity);
+        ht_index_t ret_idx;
+        // keys in the old table are unique (or allowed duplicates for multimaps), no compares needed
+        ProbeResult res = probe_any_free_idx(ht, old_entry.stored_hash, new_start_idx, &ret_idx);
         assert(res != PROBE_ERROR);
+        (void)res; // only checked by the assert
         memcpy(&ht->arr[ret_idx], &old_entry, sizeof(Hashentry));
+        used_bits_set(ht, ret_idx);
     }
-    free(old_arr);
+    free_entries(ht, old_arr, old_cap);
+    HT_STAT_ADD(ht, resizes, 1);
+    HT_STAT_ADD(ht, resize_ns, monotonic_ns() - rebuild_start);
     return true;
 }
 
 
-ProbeResult probe_free_idx(
+// probe_free_idx for one strategy, instantiated per strategy below
+static HT_ALWAYS_INLINE ProbeResult probe_free_idx_with(
     const Hashtable *ht,
     const void *key,
     const uint64_t key_hash,
-    const unsigned int start_idx,
-    unsigned int *out_idx
+    const ht_index_t start_idx,
+    ht_index_t *out_idx,
+    const HTProbeStrategy strategy
 ) {
     if (ht->count == ht->capacity) {
         fprintf(stderr, "Hashtable is full, unable to add new elements.\n");
         return PROBE_ERROR;
     }
 
-    unsigned int curr_idx = start_idx;
-    unsigned int x = 0;
-    int first_deleted_idx = -1;
+    const ht_index_t stride = probe_stride(strategy, key_hash, ht->capacity);
+    ht_index_t curr_idx = start_idx;
+    ht_index_t x = 0;
+    ht_index_t first_deleted_idx = HT_INDEX_MAX; // HT_INDEX_MAX is never a slot, capacity is at most a prime below it
     Hashentry *arr = ht->arr;
     bool probe_exhausted = false;
 
@@ -178,16 +884,19 @@ ProbeResult probe_free_idx(
         Hashentry entry = ht->arr[curr_idx];
         switch (entry.state) {
         case ENTRY_UNUSED: 
-            *out_idx = (unsigned int)(first_deleted_idx != -1 ? first_deleted_idx : curr_idx);
+            *out_idx = first_deleted_idx != HT_INDEX_MAX ? first_deleted_idx : curr_idx;
+            record_probe_length(ht, x + 1);
             return PROBE_KEY_NOT_FOUND;
         case ENTRY_DELETED: 
-            if (first_deleted_idx == -1) {
+            HT_STAT_ADD(ht, tombstones_seen, 1);
+            if (first_deleted_idx == HT_INDEX_MAX) {
                 first_deleted_idx = curr_idx;
             }
             break;
         case ENTRY_USED:
             if (arr[curr_idx].stored_hash == key_hash && memcmp(arr[curr_idx].key, key, ht->key_size) == 0) {
                 *out_idx = curr_idx;
+                record_probe_length(ht, x + 1);
                 return PROBE_KEY_FOUND;
             }
             break;
@@ -195,15 +904,16 @@ ProbeResult probe_free_idx(
             assert(false);
         }
         
-        curr_idx = (start_idx + probe_offset(++x)) % ht->capacity;
+        curr_idx = probe_step(ht, strategy, stride, start_idx, curr_idx, ++x);
         if (x >= ht->capacity) {
             probe_exhausted = true;
             break;
         }
     }
 
-    if (first_deleted_idx != -1) { // only a deleted index was found, use it
-        *out_idx = (unsigned int)first_deleted_idx;
+    if (first_deleted_idx != HT_INDEX_MAX) { // only a deleted index was found, use it
+        *out_idx = first_deleted_idx;
+        record_probe_length(ht, x);
         return PROBE_KEY_NOT_FOUND;
     }
 
@@ -211,82 +921,137 @@ ProbeResult probe_free_idx(
     return PROBE_ERROR;
 
 }
-bool hashtable_put(Hashtable *ht, const void *key, void *value) {
-    if (!ht || !key || !value) {
+
+HASHTABLE_API ProbeResult probe_free_idx(
+    const Hashtable *ht,
+    const void *key,
+    const uint64_t key_hash,
+    const ht_index_t start_idx,
+    ht_index_t *out_idx
+) {
+    switch (ht->probe) {
+    case HT_PROBE_QUADRATIC: return probe_free_idx_with(ht, key, key_hash, start_idx, out_idx, HT_PROBE_QUADRATIC);
+    case HT_PROBE_DOUBLE: return probe_free_idx_with(ht, key, key_hash, start_idx, out_idx, HT_PROBE_DOUBLE);
+    default: return probe_free_idx_with(ht, key, key_hash, start_idx, out_idx, HT_PROBE_LINEAR);
+    }
+}
+static inline bool hashtable_put_entry(Hashtable *ht, const void *key, void *value);
+
+HASHTABLE_API bool hashtable_put(Hashtable *ht, const void *key, void *value) {
+    if (!ht || !key || (!value && ht->value_size > 0)) {
         fprintf(stderr, "Hashtable_put failed, check the hashtable pointer is valid plus key/value usage\n");
         return false;
     }
+    TRACE_RECORD(ht, HT_TRACE_PUT, key, 0);
+    LATENCY_BEGIN();
+    bool put = hashtable_put_entry(ht, key, value);
+    LATENCY_END(ht, HT_LATENCY_PUT);
+    return put;
+}
+
+// twice the capacity, clamped to the largest prime so next_prime still finds one, a table already at the limit
+// fails its resize on the load factor check instead of wrapping around
+static inline ht_index_t grown_capacity(const Hashtable *ht) {
+    return ht->capacity > HT_PRIME_MAX / 2 ? HT_PRIME_MAX : 2 * ht->capacity;
+}
+
+// hashtable_put after argument checks, split out so the whole insert can be timed
+static inline bool hashtable_put_entry(Hashtable *ht, const void *key, void *value) {
     if (hashtable_load_factor(ht) >= TARGET_LOAD_FACTOR) {
-        if (!hashtable_resize(ht, 2 * ht->capacity)) {
+        if (!resize_table(ht, grown_capacity(ht))) {
             fprintf(stderr, "hashtable_put failed due to failed resize\n");
             return false;
         }
     }
-    uint64_t hash = hash_func(key, ht->key_size);
-    unsigned int start_idx = hash % ht->capacity;
-    unsigned int free_idx;
-    ProbeResult result = probe_free_idx(ht, key, hash, start_idx, &free_idx);
+    HT_STAT_ADD(ht, puts, 1);
+    uint64_t hash = hash_func(ht, key);
+    ht_index_t start_idx = home_idx(hash, ht->capacity);
+    ht_index_t free_idx;
+    // multimaps always insert a new entry, duplicates of a key end up along the same probe sequence
+    ProbeResult result = ht->multimap ? probe_any_free_idx(ht, hash, start_idx, &free_idx)
+                                      : probe_free_idx(ht, key, hash, start_idx, &free_idx);
     if (result == PROBE_ERROR) {
-        if (!hashtable_resize(ht, 2 * ht->capacity)) {
+        if (!resize_table(ht, grown_capacity(ht))) {
             fprintf(stderr, "Failed to resize/expand table after probe_free_idx exhaustion.\n");
             return false;
         }
-        result = probe_free_idx(ht, key, hash, start_idx, &free_idx);
+        start_idx = home_idx(hash, ht->capacity); // the capacity changed so the start index must be recomputed
+        result = ht->multimap ? probe_any_free_idx(ht, hash, start_idx, &free_idx)
+                              : probe_free_idx(ht, key, hash, start_idx, &free_idx);
     }
     if (result == PROBE_KEY_FOUND) {
-        memcpy((char *)ht->arr[free_idx].value, (char *)value, ht->value_size);
+        if (ht->value_size > 0) {
+            memcpy((char *)ht->arr[free_idx].value, (char *)value, ht->value_size);
+        }
         return true;
     }
 
     // this is the PROBE_KEY_NOT_FOUND case, allocation and placement of the key/val must take place
     Hashentry *entry = &ht->arr[free_idx];
-    entry->key = malloc(ht->key_size);
+    entry->key = ht_alloc(ht, ht->key_size);
     if (!entry->key) {
+        HT_USDT2(alloc_fail, ht, ht->key_size);
         fprintf(stderr, "failed to allocate memory for HashEntry key\n");
         return false;
     }
     memcpy(entry->key, key, ht->key_size);
 
-    entry->value = malloc(ht->value_size);
-    if (!entry->value) {
-        fprintf(stderr, "failed to allocate memory for HashEntry value/data \n");
-        free(entry->key);
-        return false;
+    if (ht->value_size > 0) {
+        entry->value = ht_alloc(ht, ht->value_size);
+        if (!entry->value) {
+            HT_USDT2(alloc_fail, ht, ht->value_size);
+            fprintf(stderr, "failed to allocate memory for HashEntry value/data \n");
+            ht_free(ht, entry->key, ht->key_size);
+            entry->key = NULL;
+            return false;
+        }
+        memcpy(entry->value, value, ht->value_size);
     }
-    memcpy(entry->value, value, ht->value_size);
 
+    if (entry->state == ENTRY_DELETED) {
+        ht->tombstones--;
+    }
     entry->state = ENTRY_USED;
     entry->stored_hash = hash;
+    used_bits_set(ht, free_idx);
     ht->count++;
     return true;
 }
 
-ProbeResult probe_used_idx(const Hashtable *ht, const void *key, unsigned int *used_idx) {
+// probe_used_idx for one strategy, instantiated per strategy below
+static HT_ALWAYS_INLINE ProbeResult probe_used_idx_with(const Hashtable *ht, const void *key, ht_index_t *used_idx,
+                                                        const HTProbeStrategy strategy) {
     if (ht->count == ht->capacity) {
         fprintf(stderr, "Cannot probe for next used index in Hashtable since count equals capacity.\n");
         return PROBE_ERROR;
     }
-    // unsigned long key_hash = hash_func(key, ht->key_size);
-    uint64_t key_hash = hash_func(key, ht->key_size);
-    unsigned int start_idx = key_hash % ht->capacity;
-    unsigned int curr_idx = start_idx;
-    unsigned int x = 0;
+    HT_STAT_ADD(ht, finds, 1);
+    uint64_t key_hash = hash_func(ht, key);
+    ht_index_t start_idx = home_idx(key_hash, ht->capacity);
+    const ht_index_t stride = probe_stride(strategy, key_hash, ht->capacity);
+    ht_index_t curr_idx = start_idx;
+    ht_index_t x = 0;
     
     do {
         Hashentry entry = ht->arr[curr_idx];
         switch (entry.state) {
         case ENTRY_UNUSED:
+            HT_STAT_ADD(ht, misses, 1);
+            record_probe_length(ht, x + 1);
             return PROBE_KEY_NOT_FOUND;
 
         case ENTRY_USED: {
             if (entry.stored_hash == key_hash && memcmp(key, entry.key, ht->key_size) == 0) {
                 *used_idx = curr_idx;
+                HT_STAT_ADD(ht, hits, 1);
+                record_probe_length(ht, x + 1);
                 return PROBE_KEY_FOUND;
             }
             break;
         }
 
         case ENTRY_DELETED: // pass over tombstones 
+            HT_STAT_ADD(ht, tombstones_seen, 1);
             break;
 
         default:
@@ -296,27 +1061,38 @@ ProbeResult probe_used_idx(const Hashtable *ht, const void *key, unsigned int *u
 
         // reaching here means a probe must take place
         if (++x >= ht->capacity) {
-            return PROBE_KEY_NOT_FOUND;
+            break;
         }
-        curr_idx = (start_idx + probe_offset(x)) % ht->capacity;
+        curr_idx = probe_step(ht, strategy, stride, start_idx, curr_idx, x);
     } while (curr_idx != start_idx);
+    HT_STAT_ADD(ht, misses, 1);
+    record_probe_length(ht, x);
     return PROBE_KEY_NOT_FOUND;
 }
 
-bool hashtable_contains(const Hashtable *ht, const void *key) {
+HASHTABLE_API ProbeResult probe_used_idx(const Hashtable *ht, const void *key, ht_index_t *used_idx) {
+    switch (ht->probe) {
+    case HT_PROBE_QUADRATIC: return probe_used_idx_with(ht, key, used_idx, HT_PROBE_QUADRATIC);
+    case HT_PROBE_DOUBLE: return probe_used_idx_with(ht, key, used_idx, HT_PROBE_DOUBLE);
+    default: return probe_used_idx_with(ht, key, used_idx, HT_PROBE_LINEAR);
+    }
+}
+
+HASHTABLE_API bool hashtable_contains(const Hashtable *ht, const void *key) {
+    TRACE_RECORD(ht, HT_TRACE_FIND, key, 0);
     if (hashtable_empty(ht)) {
         fprintf(stderr, "hashtable_contains called on empty hashtable\n");
         return false;
     }
-    unsigned int _;
+    ht_index_t _;
     return probe_used_idx(ht, key, &_) == PROBE_KEY_FOUND;
 }
 
-bool hashtable_empty(const Hashtable *ht) {
+HASHTABLE_API bool hashtable_empty(const Hashtable *ht) {
     return ht->count == 0;
 }
 
-unsigned int hashtable_count(const Hashtable *ht) {
+HASHTABLE_API ht_index_t hashtable_count(const Hashtable *ht) {
     return ht->count;
 }
 
@@ -325,75 +1101,327 @@ unsigned int hashtable_count(const Hashtable *ht) {
 // otherwise this function is being called tto intialize a truly new Entry and gets ENTRY_UNUSED
 // this is not called by hashtable_put since by the time put is called it should have already been initialize
 // either by the init function or resize function which initializes a new table during resizing
-void hashtable_init_entry(Hashtable *ht, unsigned int entry_idx, EntryState state) {
+HASHTABLE_API void hashtable_init_entry(Hashtable *ht, ht_index_t entry_idx, EntryState state) {
 
     if (state == ENTRY_DELETED) {
-        free(ht->arr[entry_idx].key);
-        free(ht->arr[entry_idx].value);
+        ht_free(ht, ht->arr[entry_idx].key, ht->key_size);
+        ht_free(ht, ht->arr[entry_idx].value, ht->value_size);
+        HT_STAT_ADD(ht, removes, 1);
+        ht->tombstones++;
     }
     ht->arr[entry_idx].state = state;
+    if (state == ENTRY_USED) {
+        used_bits_set(ht, entry_idx);
+    } else {
+        used_bits_clear(ht, entry_idx);
+    }
     ht->arr[entry_idx].stored_hash = 0;
     ht->arr[entry_idx].key = NULL;
     ht->arr[entry_idx].value = NULL;
 }
 
-void hashtable_remove(Hashtable *ht, const void *key) {
-    if (hashtable_empty(ht)) {
-        return;
-    }
-    unsigned int used_idx;
-    if (probe_used_idx(ht, key, &used_idx) == PROBE_KEY_FOUND) {
+HASHTABLE_API void hashtable_remove(Hashtable *ht, const void *key) {
+    TRACE_RECORD(ht, HT_TRACE_REMOVE, key, 0);
+    LATENCY_BEGIN();
+    ht_index_t used_idx;
+    if (!hashtable_empty(ht) && probe_used_idx(ht, key, &used_idx) == PROBE_KEY_FOUND) {
         hashtable_init_entry(ht, used_idx, ENTRY_DELETED);
         ht->count--;
     }
+    LATENCY_END(ht, HT_LATENCY_REMOVE);
 }
 
-void hashtable_clear(Hashtable *ht) {
-    for (unsigned int i = 0; i < ht->capacity; i++) {
+HASHTABLE_API void hashtable_clear(Hashtable *ht) {
+    TRACE_RECORD(ht, HT_TRACE_CLEAR, NULL, 0);
+    for (ht_index_t i = 0; i < ht->capacity; i++) {
+        if (ht->arr[i].state == ENTRY_USED) { // tombstones were freed on removal
+            ht_free(ht, ht->arr[i].key, ht->key_size);
+            ht_free(ht, ht->arr[i].value, ht->value_size);
+        }
         hashtable_init_entry(ht, i, ENTRY_UNUSED);
     }
     ht->count = 0;
+    ht->tombstones = 0;
 }
 
-float hashtable_load_factor(const Hashtable *ht) {
+HASHTABLE_API float hashtable_load_factor(const Hashtable *ht) {
     return ((float)ht->count / ht->capacity);
 }
 
-void *hashtable_find(const Hashtable *ht, const void *key) {
-    unsigned int used_idx;
+HASHTABLE_API void *hashtable_find(const Hashtable *ht, const void *key) {
+    TRACE_RECORD(ht, HT_TRACE_FIND, key, 0);
+    LATENCY_BEGIN();
+    void *found = NULL;
+    ht_index_t used_idx;
     ProbeResult result = probe_used_idx(ht, key, &used_idx);
     switch (result) {
     case PROBE_KEY_FOUND:
-        return ht->arr[used_idx].value;
+        // sets have no value, the stored key is returned so a non NULL result still means found
+        found = ht->value_size > 0 ? ht->arr[used_idx].value : ht->arr[used_idx].key;
+        break;
     case PROBE_KEY_NOT_FOUND:
-        return NULL;
+        break;
     case PROBE_ERROR: 
     default:
         fprintf(stderr, "Failed to perform get for Hashtable, probe_used_idx failed\n");
-        return NULL;
+        break;
     }
+    LATENCY_END(ht, HT_LATENCY_FIND);
+    return found;
 }
 
 
-void hashtable_get(const Hashtable *ht, const void *key, void *out_value) {
-    unsigned int used_idx;
-    if (probe_used_idx(ht, key, &used_idx) == PROBE_KEY_FOUND) {
+HASHTABLE_API void hashtable_get(const Hashtable *ht, const void *key, void *out_value) {
+    TRACE_RECORD(ht, HT_TRACE_FIND, key, 0);
+    ht_index_t used_idx;
+    // sets store no value, out_value may be NULL
+    if (probe_used_idx(ht, key, &used_idx) == PROBE_KEY_FOUND && ht->value_size != 0) {
         memcpy((char *)out_value, ht->arr[used_idx].value, ht->value_size);
     }
 }
 
 
-void hashtable_stats(Hashtable *ht, char *message) {
+// malloc chunk estimate for a 16 byte aligned allocator with an 8 byte header and 32 byte minimum chunk
+static inline size_t malloc_chunk_estimate(size_t requested) {
+    size_t chunk = (requested + sizeof(size_t) + 15) & ~(size_t)15;
+    return chunk < 32 ? 32 : chunk;
+}
+
+// bytes the allocator actually uses for a malloc(requested) block, header included
+static inline size_t malloc_chunk_bytes(void *ptr, size_t requested) {
+#if defined(__GLIBC__)
+    (void)requested;
+    return malloc_usable_size(ptr) + sizeof(size_t);
+#else
+    (void)ptr;
+    return malloc_chunk_estimate(requested);
+#endif
+}
+
+// every HTMemoryUsage field that follows from the counts, the key/value blocks are left to the caller
+static HTMemoryUsage memory_usage_counts(const Hashtable *ht) {
+    HTMemoryUsage usage;
+    memset(&usage, 0, sizeof(usage));
+    usage.entry_array_bytes = (size_t)ht->capacity * sizeof(Hashentry);
+    usage.metadata_bytes = used_bits_words(ht->capacity) * sizeof(uint64_t);
+#ifdef HASHTABLE_STATS
+    usage.metadata_bytes += sizeof(HTStats);
+#endif
+#ifdef HASHTABLE_LATENCY
+    usage.metadata_bytes += sizeof(HTLatency);
+#endif
+    usage.key_bytes = (size_t)ht->count * ht->key_size;
+    usage.value_bytes = (size_t)ht->count * ht->value_size;
+    usage.tombstones = ht->tombstones;
+    usage.tombstone_slot_bytes = (size_t)ht->tombstones * sizeof(Hashentry);
+    usage.empty_slot_bytes = (size_t)(ht->capacity - ht->count - ht->tombstones) * sizeof(Hashentry);
+    return usage;
+}
+
+// malloc chunk of a block the slab arena passed on to malloc, 0 for blocks carved from its chunks
+static inline size_t arena_large_block_bytes(size_t size) {
+    return size > HT_SLAB_MAX_BLOCK ? malloc_chunk_estimate(size) : 0;
+}
+
+// fills in the totals from the bytes held for key/value blocks (malloc chunks of a default table)
+static void memory_usage_finish(const Hashtable *ht, HTMemoryUsage *usage, size_t chunk_bytes) {
+    if (ht->arena) {
+        // small key/value blocks live in the arena's chunks, including its free lists and uncarved space,
+        // larger ones are separate malloc chunks
+        size_t large_bytes = arena_large_block_bytes(ht->key_size) + arena_large_block_bytes(ht->value_size);
+        chunk_bytes = hashtable_slab_arena_reserved(ht->arena) + (size_t)ht->count * large_bytes;
+    } else if (ht->allocator.kind != HT_ALLOCATOR_DEFAULT) {
+        chunk_bytes = usage->key_bytes + usage->value_bytes;
+    }
+    size_t block_bytes = usage->key_bytes + usage->value_bytes;
+    usage->malloc_overhead_bytes = chunk_bytes > block_bytes ? chunk_bytes - block_bytes : 0;
+    usage->total_bytes = usage->entry_array_bytes + usage->metadata_bytes + chunk_bytes;
+    usage->bytes_per_element = ht->count ? (double)usage->total_bytes / ht->count : 0.0;
+}
+
+HASHTABLE_API HTMemoryUsage hashtable_memory_usage(const Hashtable *ht) {
+    HTMemoryUsage usage;
+    memset(&usage, 0, sizeof(usage));
+    if (!ht || !ht->arr) {
+        return usage;
+    }
+    usage = memory_usage_counts(ht);
+    size_t chunk_bytes = 0;
+    if (ht->allocator.kind == HT_ALLOCATOR_DEFAULT) {
+        for (ht_index_t i = 0; i < ht->capacity; i++) {
+            const Hashentry *entry = &ht->arr[i];
+            if (entry->state == ENTRY_USED) {
+                chunk_bytes += malloc_chunk_bytes(entry->key, ht->key_size);
+                if (ht->value_size > 0) {
+                    chunk_bytes += malloc_chunk_bytes(entry->value, ht->value_size);
+                }
+            }
+        }
+    }
+    memory_usage_finish(ht, &usage, chunk_bytes);
+    return usage;
+}
+
+HASHTABLE_API HTMemoryUsage hashtable_memory_estimate(const Hashtable *ht) {
+    HTMemoryUsage usage;
+    memset(&usage, 0, sizeof(usage));
+    if (!ht || !ht->arr) {
+        return usage;
+    }
+    usage = memory_usage_counts(ht);
+    size_t block_bytes = malloc_chunk_estimate(ht->key_size) + (ht->value_size > 0 ? malloc_chunk_estimate(ht->value_size) : 0);
+    memory_usage_finish(ht, &usage, (size_t)ht->count * block_bytes);
+    return usage;
+}
+
+HASHTABLE_API void hashtable_stats(Hashtable *ht, char *message) {
     if (!ht) {
         fprintf(stderr, "hashtable_stats , nothing to print - the table pointer is NULL\n");
         return;
     }
-    printf("%s count: %d, cap: %d, load factor: %f\n", message ? message : "",
-         ht->count, ht->capacity, (float)ht->count/ht->capacity);
+    printf("%s count: %llu, cap: %llu, load factor: %f\n", message ? message : "",
+         (unsigned long long)ht->count, (unsigned long long)ht->capacity, (float)ht->count/ht->capacity);
+    HTMemoryUsage usage = hashtable_memory_usage(ht);
+    printf("  memory: %zu bytes (%.1f per element), entries: %zu, keys: %zu, values: %zu, malloc overhead: %zu, "
+         "empty slots: %zu, tombstones: %llu (%zu bytes)\n",
+         usage.total_bytes, usage.bytes_per_element, usage.entry_array_bytes, usage.key_bytes, usage.value_bytes,
+         usage.malloc_overhead_bytes, usage.empty_slot_bytes, (unsigned long long)usage.tombstones, usage.tombstone_slot_bytes);
+#ifdef HASHTABLE_STATS
+    const HTStats *stats = ht->stats;
+    uint64_t probes = 0;
+    for (unsigned int i = 0; i < HT_STATS_PROBE_BUCKETS; i++) {
+        probes += stats->probe_hist[i];
+    }
+    printf("  puts: %llu, finds: %llu (hits: %llu, misses: %llu), removes: %llu\n",
+         (unsigned long long)stats->puts, (unsigned long long)stats->finds, (unsigned long long)stats->hits,
+         (unsigned long long)stats->misses, (unsigned long long)stats->removes);
+    printf("  probe mean: %.3f, max: %llu, tombstones seen: %llu, resizes: %llu (%.3f ms)\n",
+         probes ? (double)stats->probe_total / probes : 0.0, (unsigned long long)stats->probe_max,
+         (unsigned long long)stats->tombstones_seen, (unsigned long long)stats->resizes, stats->resize_ns / 1e6);
+    printf("  probe length histogram:");
+    for (unsigned int i = 0; i < HT_STATS_PROBE_BUCKETS; i++) {
+        printf(" %u%s:%llu", i + 1, i == HT_STATS_PROBE_BUCKETS - 1 ? "+" : "", (unsigned long long)stats->probe_hist[i]);
+    }
+    printf("\n");
+#endif
+#ifdef HASHTABLE_LATENCY
+    static const char *op_names[HT_LATENCY_OP_COUNT] = {"put", "find", "remove", "resize"};
+    for (unsigned int op = 0; op < HT_LATENCY_OP_COUNT; op++) {
+        HTLatencySummary summary = hashtable_latency_summary(ht, (HTLatencyOp)op);
+        printf("  %s latency ticks, n: %llu, mean: %.1f, p50: %llu, p99: %llu, p99.9: %llu, max: %llu\n", op_names[op],
+             (unsigned long long)summary.count, summary.mean, (unsigned long long)summary.p50,
+             (unsigned long long)summary.p99, (unsigned long long)summary.p999, (unsigned long long)summary.max);
+    }
+#endif
+}
+
+#ifdef HASHTABLE_STATS
+HASHTABLE_API void hashtable_get_stats(const Hashtable *ht, HTStats *out) {
+    memcpy(out, ht->stats, sizeof(HTStats));
+}
+
+HASHTABLE_API void hashtable_reset_stats(Hashtable *ht) {
+    memset(ht->stats, 0, sizeof(HTStats));
+}
+#endif
+
+#ifdef HASHTABLE_TRACE
+HASHTABLE_API bool hashtable_trace_start(Hashtable *ht, const char *path, bool hashed_keys) {
+    if (!ht || !path) {
+        fprintf(stderr, "hashtable_trace_start requires a valid table and path\n");
+        return false;
+    }
+    hashtable_trace_stop(ht);
+    HTTrace *trace = (HTTrace *)malloc(sizeof(HTTrace));
+    FILE *file = fopen(path, "wb");
+    if (!trace || !file) {
+        fprintf(stderr, "hashtable_trace_start unable to open trace file %s\n", path);
+        free(trace);
+        if (file) fclose(file);
+        return false;
+    }
+    fwrite(HT_TRACE_MAGIC, 1, sizeof(HT_TRACE_MAGIC) - 1, file);
+    trace_u32(file, (uint32_t)ht->key_size);
+    trace_u32(file, (uint32_t)ht->value_size);
+    trace_u32(file, hashed_keys ? HT_TRACE_HASHED_KEYS : 0);
+    // the header keeps 32 bit capacities, larger tables replay from UINT32_MAX and follow the recorded resizes
+    trace_u32(file, ht->capacity > UINT32_MAX ? UINT32_MAX : (uint32_t)ht->capacity);
+    trace->file = file;
+    trace->last_ns = monotonic_ns();
+    trace->hashed_keys = hashed_keys;
+    ht->trace = trace;
+    return true;
+}
+
+HASHTABLE_API void hashtable_trace_stop(Hashtable *ht) {
+    if (!ht || !ht->trace) {
+        return;
+    }
+    fclose(ht->trace->file);
+    free(ht->trace);
+    ht->trace = NULL;
 }
+#endif
 
+#ifdef HASHTABLE_LATENCY
+HASHTABLE_API uint64_t hashtable_latency_percentile(const Hashtable *ht, HTLatencyOp op, double fraction) {
+    const HTLatencyHistogram *hist = &ht->latency->ops[op];
+    if (hist->count == 0) {
+        return 0;
+    }
+    // rank of the sample at the fraction, 1 based so fraction 0 gives the smallest sample
+    uint64_t rank = (uint64_t)(fraction * hist->count + 0.999999);
+    if (rank < 1) rank = 1;
+    if (rank > hist->count) rank = hist->count;
+    uint64_t seen = 0;
+    for (unsigned int bucket = 0; bucket < HT_LATENCY_BUCKETS; bucket++) {
+        seen += hist->buckets[bucket];
+        if (seen >= rank) {
+            uint64_t high = latency_bucket_high(bucket);
+            return high < hist->max ? high : hist->max;
+        }
+    }
+    return hist->max;
+}
 
-const Hashentry* HTIterator_start(HTIterator *iterator, Hashtable *ht) {
+HASHTABLE_API HTLatencySummary hashtable_latency_summary(const Hashtable *ht, HTLatencyOp op) {
+    const HTLatencyHistogram *hist = &ht->latency->ops[op];
+    HTLatencySummary summary;
+    summary.count = hist->count;
+    summary.mean = hist->count ? (double)hist->total / hist->count : 0.0;
+    summary.p50 = hashtable_latency_percentile(ht, op, 0.50);
+    summary.p99 = hashtable_latency_percentile(ht, op, 0.99);
+    summary.p999 = hashtable_latency_percentile(ht, op, 0.999);
+    summary.max = hist->max;
+    return summary;
+}
+
+HASHTABLE_API void hashtable_latency_reset(Hashtable *ht) {
+    memset(ht->latency, 0, sizeof(HTLatency));
+}
+
+static double latency_ticks_per_ns;
+static pthread_once_t latency_calibrated = PTHREAD_ONCE_INIT;
+
+static void latency_calibrate(void) {
+    uint64_t ns_start = monotonic_ns();
+    uint64_t ticks_start = latency_ticks();
+    uint64_t ns_end;
+    do {
+        ns_end = monotonic_ns();
+    } while (ns_end - ns_start < 10000000);
+    latency_ticks_per_ns = (double)(latency_ticks() - ticks_start) / (double)(ns_end - ns_start);
+}
+
+HASHTABLE_API double hashtable_latency_ticks_per_ns(void) {
+    // calibrated once on first use, pthread_once makes concurrent first callers wait for the result
+    pthread_once(&latency_calibrated, latency_calibrate);
+    return latency_ticks_per_ns;
+}
+#endif
+
+
+HASHTABLE_API const Hashentry* HTIterator_start(HTIterator *iterator, Hashtable *ht) {
     if (!iterator || !ht) {
         fprintf(stderr, "A valid Iterator pointer and hashtable pointer are needed for HTIterator_init");
         return NULL;
@@ -403,14 +1431,430 @@ const Hashentry* HTIterator_start(HTIterator *iterator, Hashtable *ht) {
     return HTIterator_next(iterator);
 }
 
-const Hashentry* HTIterator_next(HTIterator *iterator) {
-    while (iterator->curr_idx < iterator->ht->capacity) {
-        if (iterator->ht->arr[iterator->curr_idx].state == ENTRY_USED) {
-            Hashentry *entry = &iterator->ht->arr[iterator->curr_idx];
-            iterator->curr_idx++;
+// first ENTRY_USED index in [idx, end), or end. The occupancy bitmap lets empty and deleted runs
+// be skipped 64 slots at a time
+static inline ht_index_t next_used_idx(const Hashtable *ht, ht_index_t idx, ht_index_t end) {
+    while (idx < end) {
+        uint64_t word = ht->used_bits[idx / 64] >> (idx % 64);
+        if (word) {
+            idx += ctz64(word); // bits past capacity are never set so idx stays in range
+            return idx < end ? idx : end;
+        }
+        idx = (idx / 64 + 1) * 64;
+    }
+    return end;
+}
+
+HASHTABLE_API const Hashentry* HTIterator_next(HTIterator *iterator) {
+    const Hashtable *ht = iterator->ht;
+    ht_index_t idx = next_used_idx(ht, iterator->curr_idx, ht->capacity);
+    if (idx == ht->capacity) {
+        iterator->curr_idx = ht->capacity;
+        return NULL;
+    }
+    iterator->curr_idx = idx + 1;
+    return &ht->arr[idx];
+}
+
+HASHTABLE_API bool hashtableset_init(Hashtable *set, const size_t key_size, const ht_index_t base_capacity) {
+    return hashtable_init(set, key_size, 0, base_capacity);
+}
+
+HASHTABLE_API bool hashtableset_insert(Hashtable *set, const void *key) {
+    return hashtable_put(set, key, NULL);
+}
+
+HASHTABLE_API bool hashtableset_contains(const Hashtable *set, const void *key) {
+    TRACE_RECORD(set, HT_TRACE_FIND, key, 0);
+    ht_index_t _;
+    return !hashtable_empty(set) && probe_used_idx(set, key, &_) == PROBE_KEY_FOUND;
+}
+
+HASHTABLE_API bool hashtableset_erase(Hashtable *set, const void *key) {
+    TRACE_RECORD(set, HT_TRACE_REMOVE, key, 0);
+    ht_index_t used_idx;
+    if (hashtable_empty(set) || probe_used_idx(set, key, &used_idx) != PROBE_KEY_FOUND) {
+        return false;
+    }
+    hashtable_init_entry(set, used_idx, ENTRY_DELETED);
+    set->count--;
+    return true;
+}
+
+// grows the table once upfront so bulk inserts of `incoming` keys don't resize repeatedly
+static bool hashtableset_reserve(Hashtable *set, size_t incoming) {
+    size_t needed = (size_t)((set->count + incoming) / TARGET_LOAD_FACTOR) + 1;
+    if (needed > HT_PRIME_MAX) {
+        fprintf(stderr, "hashtableset would exceed the capacity limit, build with HASHTABLE_64BIT_INDEX for larger sets\n");
+        return false;
+    }
+    if (needed <= set->capacity) {
+        return true;
+    }
+    return hashtable_resize(set, (ht_index_t)needed);
+}
+
+HASHTABLE_API bool hashtableset_insert_all(Hashtable *set, const void *keys, size_t key_count) {
+    if (!hashtableset_reserve(set, key_count)) {
+        return false;
+    }
+    const char *key = (const char *)keys;
+    for (size_t i = 0; i < key_count; i++, key += set->key_size) {
+        if (!hashtable_put(set, key, NULL)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// set operations only make sense between sets (value_size 0) of the same key_size
+static bool hashtableset_compatible(const Hashtable *dst, const Hashtable *other, const char *op) {
+    if (dst->key_size != other->key_size || dst->value_size != 0 || other->value_size != 0) {
+        fprintf(stderr, "%s requires two sets with the same key_size\n", op);
+        return false;
+    }
+    return true;
+}
+
+HASHTABLE_API bool hashtableset_union(Hashtable *dst, const Hashtable *src) {
+    if (!hashtableset_compatible(dst, src, "hashtableset_union")) {
+        return false;
+    }
+    if (!hashtableset_reserve(dst, src->count)) {
+        return false;
+    }
+    for (ht_index_t i = 0; i < src->capacity; i++) {
+        if (src->arr[i].state == ENTRY_USED && !hashtable_put(dst, src->arr[i].key, NULL)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// removes every key of dst for which membership in other equals remove_if_member
+static void hashtableset_filter(Hashtable *dst, const Hashtable *other, bool remove_if_member) {
+    for (ht_index_t i = 0; i < dst->capacity; i++) {
+        if (dst->arr[i].state != ENTRY_USED) {
+            continue;
+        }
+        if (hashtableset_contains(other, dst->arr[i].key) == remove_if_member) {
+            TRACE_RECORD(dst, HT_TRACE_REMOVE, dst->arr[i].key, 0);
+            hashtable_init_entry(dst, i, ENTRY_DELETED);
+            dst->count--;
+        }
+    }
+}
+
+HASHTABLE_API bool hashtableset_intersect(Hashtable *dst, const Hashtable *other) {
+    if (!hashtableset_compatible(dst, other, "hashtableset_intersect")) {
+        return false;
+    }
+    hashtableset_filter(dst, other, false);
+    return true;
+}
+
+HASHTABLE_API bool hashtableset_difference(Hashtable *dst, const Hashtable *other) {
+    if (!hashtableset_compatible(dst, other, "hashtableset_difference")) {
+        return false;
+    }
+    hashtableset_filter(dst, other, true);
+    return true;
+}
+
+HASHTABLE_API bool hashtable_init_multimap(Hashtable *ht, const size_t key_size, const size_t value_size, const ht_index_t base_capacity) {
+    if (!hashtable_init(ht, key_size, value_size, base_capacity)) {
+        return false;
+    }
+    ht->multimap = true;
+    return true;
+}
+
+HASHTABLE_API struct Hashtable *_hashtable_create_multimap(size_t key_size, size_t value_size, ht_index_t new_cap) {
+    Hashtable *ht = _hashtable_create(key_size, value_size, new_cap);
+    if (ht) {
+        ht->multimap = true;
+    }
+    return ht;
+}
+
+HASHTABLE_API const Hashentry *HTEqualRange_start(HTEqualRange *range, const Hashtable *ht, const void *key) {
+    if (!range || !ht || !key) {
+        fprintf(stderr, "A valid range pointer, hashtable pointer and key are needed for HTEqualRange_start\n");
+        return NULL;
+    }
+    range->ht = ht;
+    range->key = key;
+    range->key_hash = hash_func(ht, key);
+    range->start_idx = home_idx(range->key_hash, ht->capacity);
+    range->stride = probe_stride(ht->probe, range->key_hash, ht->capacity);
+    range->curr_idx = range->start_idx;
+    range->x = hashtable_empty(ht) ? ht->capacity : 0; // nothing to walk on an empty table
+    return HTEqualRange_next(range);
+}
+
+HASHTABLE_API const Hashentry *HTEqualRange_next(HTEqualRange *range) {
+    const Hashtable *ht = range->ht;
+    const ht_index_t limit = ht->capacity;
+    while (range->x < limit) {
+        const Hashentry *entry = &ht->arr[range->curr_idx];
+        if (entry->state == ENTRY_UNUSED) { // end of the probe chain
+            range->x = limit;
+            return NULL;
+        }
+        range->curr_idx = probe_next_idx(ht, range->stride, range->start_idx, range->curr_idx, ++range->x);
+        if (entry->state == ENTRY_USED && entry->stored_hash == range->key_hash &&
+            memcmp(entry->key, range->key, ht->key_size) == 0) {
             return entry;
         }
-        iterator->curr_idx++;
     }
     return NULL;
 }
+
+HASHTABLE_API ht_index_t hashtable_find_all(const Hashtable *ht, const void *key, HTFindAllCallback callback, void *ctx) {
+    TRACE_RECORD(ht, HT_TRACE_FIND, key, 0);
+    HTEqualRange range;
+    ht_index_t matches = 0;
+    for (const Hashentry *entry = HTEqualRange_start(&range, ht, key); entry; entry = HTEqualRange_next(&range)) {
+        matches++;
+        if (callback && !callback(entry->value, ctx)) {
+            break;
+        }
+    }
+    return matches;
+}
+
+HASHTABLE_API ht_index_t hashtable_count_key(const Hashtable *ht, const void *key) {
+    return hashtable_find_all(ht, key, NULL, NULL);
+}
+
+HASHTABLE_API ht_index_t hashtable_remove_all(Hashtable *ht, const void *key) {
+    HTEqualRange range;
+    ht_index_t removed = 0;
+    // tombstones don't end the probe chain so deleting while walking the range is safe
+    for (const Hashentry *entry = HTEqualRange_start(&range, ht, key); entry; entry = HTEqualRange_next(&range)) {
+        TRACE_RECORD(ht, HT_TRACE_REMOVE, key, 0); // one per entry, a replayed remove drops a single duplicate
+        hashtable_init_entry(ht, (ht_index_t)(entry - ht->arr), ENTRY_DELETED);
+        ht->count--;
+        removed++;
+    }
+    return removed;
+}
+
+HASHTABLE_API uint64_t hashtable_scan(const Hashtable *ht, uint64_t cursor, unsigned int bucket_count, HTScanCallback callback, void *ctx) {
+    if (!ht || !callback || hashtable_empty(ht)) {
+        return 0;
+    }
+    if (ht->probe == HT_PROBE_DOUBLE) {
+        // entries sharing a home bucket each follow their own stride, a bucket can't be walked in bounded work
+        fprintf(stderr, "hashtable_scan does not support HT_PROBE_DOUBLE tables, use HTIterator\n");
+        return 0;
+    }
+    const ht_index_t limit = ht->capacity;
+    ht_index_t bucket = home_idx(cursor, ht->capacity);
+    for (unsigned int n = 0; n < bucket_count && bucket < ht->capacity; n++) {
+        // every entry whose home is bucket sits on bucket's probe sequence before its first unused slot,
+        // linear and quadratic sequences don't depend on the hash
+        ht_index_t curr_idx = bucket;
+        for (ht_index_t x = 0; x < limit && ht->arr[curr_idx].state != ENTRY_UNUSED; curr_idx = probe_next_idx(ht, 1, bucket, curr_idx, ++x)) {
+            const Hashentry *entry = &ht->arr[curr_idx];
+            // hashes below the cursor were visited by an earlier call, possibly at another capacity
+            if (entry->state == ENTRY_USED && entry->stored_hash >= cursor &&
+                home_idx(entry->stored_hash, ht->capacity) == bucket) {
+                callback(entry, ctx);
+            }
+        }
+        if (++bucket < ht->capacity) {
+            cursor = bucket_first_hash(bucket, ht->capacity);
+        }
+    }
+    return bucket < ht->capacity ? cursor : 0;
+}
+
+HASHTABLE_API bool HTIterator_erase(HTIterator *iterator) {
+    if (!iterator || !iterator->ht || iterator->curr_idx == 0) {
+        return false;
+    }
+    Hashtable *ht = iterator->ht;
+    ht_index_t idx = iterator->curr_idx - 1; // the entry most recently returned by the iterator
+    if (idx >= ht->capacity || ht->arr[idx].state != ENTRY_USED) {
+        return false;
+    }
+    TRACE_RECORD(ht, HT_TRACE_REMOVE, ht->arr[idx].key, 0); // hashtable_retain erases through here too
+    hashtable_init_entry(ht, idx, ENTRY_DELETED);
+    ht->count--;
+    return true;
+}
+
+HASHTABLE_API ht_index_t hashtable_retain(Hashtable *ht, HTRetainPredicate predicate, void *ctx) {
+    if (!ht || !predicate) {
+        return 0;
+    }
+    ht_index_t removed = 0;
+    HTIterator itr;
+    for (const Hashentry *entry = HTIterator_start(&itr, ht); entry; entry = HTIterator_next(&itr)) {
+        if (!predicate(entry->key, entry->value, ctx)) {
+            HTIterator_erase(&itr);
+            removed++;
+        }
+    }
+    // a same size rebuild clears the tombstones just created along with any older ones
+    if (removed > 0 && !hashtable_rebuild(ht, ht->capacity)) {
+        fprintf(stderr, "hashtable_retain failed to rebuild, tombstones were kept\n");
+    }
+    return removed;
+}
+
+HASHTABLE_API void HTSlotRange_init(HTSlotRange *range, const Hashtable *ht, ht_index_t begin, ht_index_t end) {
+    range->ht = ht;
+    range->end = end < ht->capacity ? end : ht->capacity;
+    range->begin = begin < range->end ? begin : range->end;
+    range->curr_idx = range->begin;
+}
+
+HASHTABLE_API bool HTSlotRange_split(HTSlotRange *range, HTSlotRange *upper) {
+    // split on a bitmap word boundary so the halves never share a word of used_bits
+    ht_index_t mid = ((range->curr_idx + (range->end - range->curr_idx) / 2) / 64) * 64;
+    if (mid <= range->curr_idx || mid >= range->end) {
+        return false;
+    }
+    HTSlotRange_init(upper, range->ht, mid, range->end);
+    range->end = mid;
+    return true;
+}
+
+HASHTABLE_API const Hashentry *HTSlotRange_next(HTSlotRange *range) {
+    ht_index_t idx = next_used_idx(range->ht, range->curr_idx, range->end);
+    range->curr_idx = idx < range->end ? idx + 1 : range->end;
+    return idx < range->end ? &range->ht->arr[idx] : NULL;
+}
+
+// slots handed out per work item in hashtable_foreach_parallel, a multiple of 64 (one bitmap word)
+#define FOREACH_CHUNK_SLOTS 4096
+
+typedef struct ForeachWorker {
+    const Hashtable *ht;
+    HTForeachCallback callback;
+    void *ctx;
+    _Atomic ht_index_t *next_chunk; // shared work queue, the next chunk index to process
+    ht_index_t chunk_count;
+    unsigned int thread_idx;
+} ForeachWorker;
+
+static void *hashtable_foreach_worker(void *arg) {
+    ForeachWorker *worker = (ForeachWorker *)arg;
+    ht_index_t chunk;
+    // chunks are claimed dynamically so a thread that hits a dense region doesn't hold everyone up
+    while ((chunk = atomic_fetch_add(worker->next_chunk, 1)) < worker->chunk_count) {
+        // 64 bit so the last chunk's end can't wrap around a 32 bit index, HTSlotRange_init clamps to the capacity
+        uint64_t begin = (uint64_t)chunk * FOREACH_CHUNK_SLOTS;
+        uint64_t end = begin + FOREACH_CHUNK_SLOTS;
+        HTSlotRange range;
+        HTSlotRange_init(&range, worker->ht, (ht_index_t)begin, end < worker->ht->capacity ? (ht_index_t)end : worker->ht->capacity);
+        for (const Hashentry *entry = HTSlotRange_next(&range); entry; entry = HTSlotRange_next(&range)) {
+            worker->callback(entry, worker->thread_idx, worker->ctx);
+        }
+    }
+    return NULL;
+}
+
+HASHTABLE_API bool hashtable_foreach_parallel(const Hashtable *ht, HTForeachCallback callback, void *ctx, unsigned int nthreads) {
+    if (!ht || !callback) {
+        fprintf(stderr, "hashtable_foreach_parallel requires a valid table and callback\n");
+        return false;
+    }
+    ht_index_t chunk_count = (ht_index_t)(((uint64_t)ht->capacity + FOREACH_CHUNK_SLOTS - 1) / FOREACH_CHUNK_SLOTS);
+    if (nthreads < 1) {
+        nthreads = 1;
+    }
+    if (nthreads > chunk_count) {
+        nthreads = chunk_count;
+    }
+    _Atomic ht_index_t next_chunk;
+    atomic_init(&next_chunk, 0);
+    ForeachWorker *workers = (ForeachWorker *)malloc(nthreads * sizeof(ForeachWorker));
+    pthread_t *threads = (pthread_t *)malloc(nthreads * sizeof(pthread_t));
+    if (!workers || !threads) {
+        fprintf(stderr, "failed to allocate workers for hashtable_foreach_parallel\n");
+        free(workers);
+        free(threads);
+        return false;
+    }
+    unsigned int started = 1; // the calling thread is worker 0
+    for (unsigned int i = 0; i < nthreads; i++) {
+        workers[i] = (ForeachWorker){ht, callback, ctx, &next_chunk, chunk_count, i};
+        if (i > 0) {
+            if (pthread_create(&threads[i], NULL, hashtable_foreach_worker, &workers[i]) != 0) {
+                // fewer threads only means less parallelism, the remaining chunks are still claimed
+                break;
+            }
+            started++;
+        }
+    }
+    hashtable_foreach_worker(&workers[0]);
+    for (unsigned int i = 1; i < started; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    free(workers);
+    free(threads);
+    return true;
+}
+
+HASHTABLE_API bool hashtable_set_hash(Hashtable *ht, HTHashKind hash_kind, HTHashFunc custom) {
+    if (!ht || (hash_kind == HT_HASH_CUSTOM && !custom)) {
+        fprintf(stderr, "hashtable_set_hash requires a valid table, and a function for HT_HASH_CUSTOM\n");
+        return false;
+    }
+    ht->hash_kind = hash_kind;
+    ht->hash_func = hash_kind == HT_HASH_CUSTOM ? custom : NULL;
+    if (hashtable_empty(ht)) {
+        return true;
+    }
+    // entries are placed by their old hashes, recompute them and rebuild at the same capacity
+    for (ht_index_t i = 0; i < ht->capacity; i++) {
+        if (ht->arr[i].state == ENTRY_USED) {
+            ht->arr[i].stored_hash = hash_func(ht, ht->arr[i].key);
+        }
+    }
+    return hashtable_rebuild(ht, ht->capacity);
+}
+
+HASHTABLE_API bool hashtable_set_probe(Hashtable *ht, HTProbeStrategy strategy) {
+    if (!ht || (strategy != HT_PROBE_LINEAR && strategy != HT_PROBE_QUADRATIC && strategy != HT_PROBE_DOUBLE)) {
+        fprintf(stderr, "hashtable_set_probe requires a valid table and strategy\n");
+        return false;
+    }
+    if (ht->probe == strategy) {
+        return true;
+    }
+    // entries are placed along the old sequences, rebuild at a capacity the new one covers
+    HTProbeStrategy old_strategy = ht->probe;
+    ht->probe = strategy;
+    if (!hashtable_rebuild(ht, ht->capacity)) {
+        ht->probe = old_strategy;
+        return false;
+    }
+    return true;
+}
+
+HASHTABLE_API ht_index_t hashtable_probe_length(const Hashtable *ht, const void *key) {
+    if (hashtable_empty(ht)) {
+        return 0;
+    }
+    uint64_t key_hash = hash_func(ht, key);
+    ht_index_t start_idx = home_idx(key_hash, ht->capacity);
+    const ht_index_t stride = probe_stride(ht->probe, key_hash, ht->capacity);
+    ht_index_t curr_idx = start_idx;
+    const ht_index_t limit = ht->capacity;
+    for (ht_index_t x = 0; x < limit; curr_idx = probe_next_idx(ht, stride, start_idx, curr_idx, ++x)) {
+        const Hashentry *entry = &ht->arr[curr_idx];
+        if (entry->state == ENTRY_UNUSED) {
+            return 0;
+        }
+        if (entry->state == ENTRY_USED && entry->stored_hash == key_hash && memcmp(entry->key, key, ht->key_size) == 0) {
+            return x + 1;
+        }
+    }
+    return 0;
+}
+
+#endif // HASHTABLE_C_INCLUDED
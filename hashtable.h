@@ -8,14 +8,133 @@
 
 #include <assert.h>
 
+// Build modes, mirroring how xxhash is consumed:
+//   default: compile hashtable.c separately and link against it
+//   #define HASHTABLE_IMPLEMENTATION before including this header in exactly one translation unit
+//       to compile the implementation into it without a separate hashtable.c object
+//   #define HASHTABLE_INLINE_ALL before including this header to make every function static inline,
+//       letting lookups inline into the calling loops and constant key sizes propagate
+#ifdef HASHTABLE_INLINE_ALL
+#define HASHTABLE_API static inline
+#else
+#define HASHTABLE_API
+#endif
+
 #ifndef TARGET_LOAD_FACTOR
 #define TARGET_LOAD_FACTOR 0.65
 #endif 
 
+// Slot indices, capacities and counts. 32 bit by default which keeps the probe arithmetic and iterators small,
+// building with HASHTABLE_64BIT_INDEX lets a table grow past 2^32 slots. Every translation unit must agree on it.
+#ifdef HASHTABLE_64BIT_INDEX
+typedef uint64_t ht_index_t;
+#define HT_INDEX_MAX UINT64_MAX
+#define HT_PRIME_MAX UINT64_C(18446744073709551557) // largest prime capacity that fits in ht_index_t
+#else
+typedef uint32_t ht_index_t;
+#define HT_INDEX_MAX UINT32_MAX
+#define HT_PRIME_MAX UINT32_C(4294967291) // largest prime capacity that fits in ht_index_t
+#endif
+
+// 128 bit arithmetic where the compiler provides it, portable fallbacks otherwise (forced with HASHTABLE_NO_INT128)
+#if defined(__SIZEOF_INT128__) && !defined(HASHTABLE_NO_INT128)
+#define HT_HAVE_INT128
+__extension__ typedef unsigned __int128 ht_uint128;
+#endif
+
+// high 64 bits of the 128 bit product a * b
+static inline uint64_t ht_mulhi64(uint64_t a, uint64_t b) {
+#ifdef HT_HAVE_INT128
+    return (uint64_t)(((ht_uint128)a * b) >> 64);
+#else
+    // schoolbook multiply of the 32 bit halves, the cross sum can't overflow and carries into the high word
+    uint64_t a_lo = (uint32_t)a, a_hi = a >> 32;
+    uint64_t b_lo = (uint32_t)b, b_hi = b >> 32;
+    uint64_t lo_lo = a_lo * b_lo;
+    uint64_t hi_lo = a_hi * b_lo;
+    uint64_t cross = (lo_lo >> 32) + (uint32_t)hi_lo + a_lo * b_hi;
+    return a_hi * b_hi + (hi_lo >> 32) + (cross >> 32);
+#endif
+}
+
+// a * b % m for m > 0
+static inline uint64_t ht_mulmod64(uint64_t a, uint64_t b, uint64_t m) {
+#ifdef HT_HAVE_INT128
+    return (uint64_t)(((ht_uint128)a * b) % m);
+#else
+    // double and add, each addition is reduced before it can wrap around
+    uint64_t result = 0;
+    a %= m;
+    for (; b; b >>= 1) {
+        if (b & 1) {
+            result = result >= m - a ? result - (m - a) : result + a;
+        }
+        a = a >= m - a ? a - (m - a) : a + a;
+    }
+    return result;
+#endif
+}
+
+// idx + step mod capacity without a division, for idx < capacity and step <= capacity
+static inline ht_index_t probe_wrap_add(ht_index_t idx, ht_index_t step, ht_index_t capacity) {
+    return idx < capacity - step ? idx + step : idx - (capacity - step);
+}
+
+// slot of the x-th linear probe (x = 0 is start_idx, x <= capacity)
+static inline ht_index_t probe_idx_linear(ht_index_t start_idx, ht_index_t x, ht_index_t capacity) {
+    return probe_wrap_add(start_idx, x, capacity);
+}
+
+/**
+ * Slot of the x-th quadratic probe (x = 0 is start_idx, x <= capacity), alternating start + k^2, start - k^2
+ * for k = 1, 2, ..: over a prime capacity = 3 mod 4 the offsets 0, +-1, +-4, .. hit every residue exactly once,
+ * so the first capacity probes visit every slot. Plain start + x^2 only reaches half of a prime table.
+ */
+static inline ht_index_t probe_idx_quadratic(ht_index_t start_idx, ht_index_t x, ht_index_t capacity) {
+    uint64_t k = ((uint64_t)x + 1) / 2;
+#ifdef HASHTABLE_64BIT_INDEX
+    ht_index_t square = (ht_index_t)(k <= UINT32_MAX ? (k * k) % capacity : ht_mulmod64(k, k, capacity));
+#else
+    ht_index_t square = (ht_index_t)((k * k) % capacity);
+#endif
+    if (x & 1) {
+        return probe_wrap_add(start_idx, square, capacity);
+    }
+    return start_idx >= square ? start_idx - square : start_idx + (capacity - square);
+}
+
+/**
+ * Maps a hash onto [0, capacity) with a multiply-shift (fastrange) instead of a modulo, shared by every table
+ * in the repo. Unlike hash % capacity this is monotonic in the hash, slot order follows hash order for every
+ * capacity, which is what lets a hashtable_scan cursor stay meaningful across resizes. It consumes the high
+ * bits, so hashes must be well mixed there.
+ */
+static inline ht_index_t home_idx(uint64_t hash, ht_index_t capacity) {
+    return (ht_index_t)ht_mulhi64(hash, capacity);
+}
+
+// probe sequence selected by QUAD_PROBING, used by the tables without a runtime strategy (OrderedHashtable,
+// FlatHashMap). hashtable_probe_capacity picks capacities it fully covers.
+static inline ht_index_t probe_idx(ht_index_t start_idx, ht_index_t x, ht_index_t capacity) {
 #ifdef QUAD_PROBING
-static inline unsigned int probe_offset(unsigned int x) {return x * x;}
-#else 
-static inline unsigned int probe_offset(unsigned int x) {return x;}
+    return probe_idx_quadratic(start_idx, x, capacity);
+#else
+    return probe_idx_linear(start_idx, x, capacity);
+#endif
+}
+
+// murmur3 64 bit finalizer, a cheap full avalanche hash for integer keys
+static inline uint64_t hashtable_mix64(uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ULL;
+    x ^= x >> 33;
+    return x;
+}
+
+#ifdef __cplusplus
+extern "C" {
 #endif
 
 typedef enum EntryState {
@@ -30,6 +149,131 @@ typedef enum ProbeResult {
     PROBE_ERROR
 } ProbeResult;
 
+// hash function signature, all hash functions must return 64 bit hashes
+typedef uint64_t (*HTHashFunc)(const void *key, size_t key_size);
+
+// per table hash selection, see hashtable_set_hash
+typedef enum HTHashKind {
+    HT_HASH_XXH64, // default
+    HT_HASH_XXH3, // faster than XXH64 on short keys
+    HT_HASH_INT, // murmur3 finalizer for 4/8 byte integer keys, XXH3 for other key sizes
+    HT_HASH_DJB2,
+    HT_HASH_CUSTOM // user supplied HTHashFunc
+} HTHashKind;
+
+// per table probe sequence, see hashtable_set_probe
+typedef enum HTProbeStrategy {
+    HT_PROBE_LINEAR, // best locality, prone to primary clustering
+    HT_PROBE_QUADRATIC, // +-k^2 steps over prime capacities = 3 mod 4
+    HT_PROBE_DOUBLE // per key step from the low half of the hash over prime capacities
+} HTProbeStrategy;
+
+// strategy of new tables, QUAD_PROBING keeps selecting quadratic probing at compile time
+#ifdef QUAD_PROBING
+#define HT_PROBE_DEFAULT HT_PROBE_QUADRATIC
+#else
+#define HT_PROBE_DEFAULT HT_PROBE_LINEAR
+#endif
+
+#ifdef HASHTABLE_STATS
+// probe length histogram buckets, bucket i counts probes of i + 1 slots and the last bucket everything longer
+#define HT_STATS_PROBE_BUCKETS 16
+
+// per table operation counters, only compiled in with HASHTABLE_STATS (every translation unit must agree on it).
+// Counters are plain integers, lookups running concurrently on one table can lose increments.
+typedef struct HTStats {
+    uint64_t puts;
+    uint64_t finds; // key lookups: find/get/contains and the lookup done by remove
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t removes; // entries turned into tombstones
+    uint64_t probe_total; // slots examined by probe_free_idx/probe_used_idx, 1 when the home slot decides it
+    uint64_t probe_max;
+    uint64_t probe_hist[HT_STATS_PROBE_BUCKETS];
+    uint64_t tombstones_seen; // ENTRY_DELETED slots stepped over while probing
+    uint64_t resizes; // rebuilds of the entry array, same capacity rebuilds (retain, set_hash) included
+    uint64_t resize_ns;
+} HTStats;
+#endif
+
+#ifdef HASHTABLE_LATENCY
+// log-linear (HDR style) histogram: values below 2^HT_LATENCY_SUB_BITS get exact buckets, every power of two
+// range above is split into 2^HT_LATENCY_SUB_BITS linear buckets, a relative error below 1/16 up to 2^64 ticks
+#define HT_LATENCY_SUB_BITS 4
+#define HT_LATENCY_BUCKETS ((64 - HT_LATENCY_SUB_BITS + 1) << HT_LATENCY_SUB_BITS)
+
+typedef enum HTLatencyOp {
+    HT_LATENCY_PUT, // includes any resize the put triggers
+    HT_LATENCY_FIND,
+    HT_LATENCY_REMOVE,
+    HT_LATENCY_RESIZE,
+    HT_LATENCY_OP_COUNT
+} HTLatencyOp;
+
+typedef struct HTLatencyHistogram {
+    uint64_t count;
+    uint64_t total; // sum of all recorded ticks
+    uint64_t max;
+    uint64_t buckets[HT_LATENCY_BUCKETS];
+} HTLatencyHistogram;
+
+// per table latency histograms, only compiled in with HASHTABLE_LATENCY (every translation unit must agree on it).
+// Times are in ticks of the cycle counter (rdtsc on x86, cntvct on arm64, nanoseconds elsewhere),
+// see hashtable_latency_ticks_per_ns. Like HTStats, concurrent lookups on one table can lose samples.
+typedef struct HTLatency {
+    HTLatencyHistogram ops[HT_LATENCY_OP_COUNT];
+} HTLatency;
+
+typedef struct HTLatencySummary {
+    uint64_t count;
+    double mean;
+    uint64_t p50;
+    uint64_t p99;
+    uint64_t p999;
+    uint64_t max;
+} HTLatencySummary;
+#endif
+
+// workload trace format, written with HASHTABLE_TRACE and read by hashtable_replay. Integers are little endian.
+//   header: HT_TRACE_MAGIC, u32 key_size, u32 value_size, u32 flags, u32 capacity when tracing started
+//   records: u8 HTTraceOp, LEB128 varint nanoseconds since the previous record, then
+//     put/find/remove: the key_size key bytes, or its u64 XXH64 hash when flags has HT_TRACE_HASHED_KEYS
+//     resize: varint desired capacity
+//     clear: nothing
+// Values are not recorded, replay puts value_size zero bytes.
+#define HT_TRACE_MAGIC "HTTRACE1"
+#define HT_TRACE_HASHED_KEYS 1u
+
+typedef enum HTTraceOp {
+    HT_TRACE_PUT = 1,
+    HT_TRACE_FIND,
+    HT_TRACE_REMOVE,
+    HT_TRACE_CLEAR,
+    HT_TRACE_RESIZE
+} HTTraceOp;
+
+// where a table's allocations come from. Recorded in the table instead of comparing function pointers, which
+// differ between translation units under HASHTABLE_INLINE_ALL and HASHTABLE_IMPLEMENTATION.
+typedef enum HTAllocatorKind {
+    HT_ALLOCATOR_USER, // a user supplied HTAllocator, the zero value so initializers without kind get it
+    HT_ALLOCATOR_DEFAULT, // malloc/free
+    HT_ALLOCATOR_SLAB // hashtable_slab_allocator
+} HTAllocatorKind;
+
+// allocator for a table's entry array, occupancy bitmap and per entry key/value blocks, the bitmap is resized with
+// realloc when the table is rebuilt. Sizes are passed back on realloc/free so fixed size pools need no block headers,
+// free(ctx, NULL, size) is a no-op.
+typedef struct HTAllocator {
+    void *(*alloc)(void *ctx, size_t size);
+    void *(*realloc)(void *ctx, void *ptr, size_t old_size, size_t new_size);
+    void (*free)(void *ctx, void *ptr, size_t size);
+    void *ctx;
+    HTAllocatorKind kind; // leave unset (HT_ALLOCATOR_USER) for custom allocators
+} HTAllocator;
+
+// slab arena, see hashtable_slab_arena_create
+typedef struct HTSlabArena HTSlabArena;
+
 typedef struct Hashentry {
     void *key; 
     void *value; 
@@ -39,60 +283,117 @@ typedef struct Hashentry {
 } Hashentry;
 
 typedef struct Hashtable {
-    unsigned int capacity;
-    unsigned int count;
+    ht_index_t capacity;
+    ht_index_t count;
+    ht_index_t tombstones; // ENTRY_DELETED slots
     size_t key_size;
-    size_t value_size; // size of the stored value associated to a key
+    size_t value_size; // size of the stored value associated to a key, 0 for sets
     Hashentry *arr; // internal array of Hashentries
+    uint64_t *used_bits; // occupancy bitmap, bit i is set when arr[i].state == ENTRY_USED
+    bool multimap; // duplicate keys allowed, hashtable_put always inserts a new entry
+    HTHashKind hash_kind;
+    HTHashFunc hash_func; // only used for HT_HASH_CUSTOM
+    HTProbeStrategy probe;
+    HTAllocator allocator;
+    HTSlabArena *arena; // arena owned by the table (hashtable_init_arena), released as a whole by hashtable_deinit
+#ifdef HASHTABLE_STATS
+    HTStats *stats; // allocated separately so lookups through a const table can count
+#endif
+#ifdef HASHTABLE_LATENCY
+    HTLatency *latency; // allocated separately for the same reason as stats
+#endif
+#ifdef HASHTABLE_TRACE
+    struct HTTrace *trace; // NULL unless hashtable_trace_start was called
+#endif
 } Hashtable;
 //TODO: macro to check if key strings 
 // initialize an empty hashtable, meant to work on a stack allocated hashtable or preallocated hashtable
-bool hashtable_init(Hashtable *ht, const size_t key_size, const size_t value_size, const unsigned int base_capacity);
+HASHTABLE_API bool hashtable_init(Hashtable *ht, const size_t key_size, const size_t value_size, const ht_index_t base_capacity);
+// hashtable_init with every table allocation going through allocator, NULL means malloc/free.
+// The allocator must outlive the table, it is copied but not owned.
+HASHTABLE_API bool hashtable_init_with_allocator(Hashtable *ht, const size_t key_size, const size_t value_size,
+                                                 const ht_index_t base_capacity, const HTAllocator *allocator);
+// hashtable_init with keys and values carved from a slab arena owned by the table: inserts reuse freed blocks or
+// bump allocate from large chunks and hashtable_deinit releases the chunks instead of freeing every entry
+HASHTABLE_API bool hashtable_init_arena(Hashtable *ht, const size_t key_size, const size_t value_size, const ht_index_t base_capacity);
+
+/**
+ * Slab arena: blocks up to HT_SLAB_MAX_BLOCK bytes are rounded to 8 (up to 8 bytes) or 16 byte size classes and
+ * carved from chunks that grow from HT_SLAB_MIN_CHUNK to HT_SLAB_MAX_CHUNK bytes, freed blocks go on a per class
+ * free list. Larger requests (entry arrays) are passed to malloc. Not thread safe, an arena can be shared by tables
+ * used from one thread through hashtable_slab_allocator and must be destroyed after all of them.
+ */
+#define HT_SLAB_MAX_BLOCK 256
+#define HT_SLAB_MIN_CHUNK (16 * 1024)
+#define HT_SLAB_MAX_CHUNK (1024 * 1024)
+HASHTABLE_API HTSlabArena *hashtable_slab_arena_create(void);
+// releases every chunk, blocks still held by tables become invalid
+HASHTABLE_API void hashtable_slab_arena_destroy(HTSlabArena *arena);
+HASHTABLE_API HTAllocator hashtable_slab_allocator(HTSlabArena *arena);
+// bytes reserved in chunks, blocks handed out plus free listed and not yet carved space
+HASHTABLE_API size_t hashtable_slab_arena_reserved(const HTSlabArena *arena);
+
+/**
+ * Building with HASHTABLE_HUGEPAGES maps entry arrays of at least HT_HUGEPAGE_MIN_BYTES on 2MB pages so random
+ * probes into large tables stop missing the dTLB: MAP_HUGETLB from the reserved pool when there is one, otherwise
+ * a 2MB aligned anonymous mapping with madvise(MADV_HUGEPAGE) for transparent huge pages. Applies to hashtable_init,
+ * resizes and HASHTABLE_DEFINE tables, tables with a custom allocator keep using it. Every translation unit must
+ * agree on the flag.
+ */
+#ifdef HASHTABLE_HUGEPAGES
+#ifndef HT_HUGEPAGE_MIN_BYTES
+#define HT_HUGEPAGE_MIN_BYTES (2 * 1024 * 1024)
+#endif
+// zeroed mapping of size rounded up to whole 2MB pages, NULL when mmap fails
+HASHTABLE_API void *hashtable_huge_alloc(size_t size);
+// size must be the one passed to hashtable_huge_alloc
+HASHTABLE_API void hashtable_huge_free(void *ptr, size_t size);
+#endif
 
 // de-initialize an empty hashtable, all internal memory related to Entries and their keys, values
 // are freed if they were allocated
-void hashtable_deinit(Hashtable *ht);
+HASHTABLE_API void hashtable_deinit(Hashtable *ht);
 
 // wrapper macro around _hashtable_create() which allocates a pointer for a hashtable 
 // with the desired capacity passed in, the first argument is the type and second 
 // the desired capacity
 #define hashtable_create(key_type, val_type , new_cap) _hashtable_create(sizeof(key_type), sizeof(val_type), new_cap);
-struct Hashtable *_hashtable_create(size_t key_size, size_t element_size, unsigned int new_cap);
+HASHTABLE_API struct Hashtable *_hashtable_create(size_t key_size, size_t element_size, ht_index_t new_cap);
 
 
 // if the EntryState passed is ENTRY_DELETED then the key/value of an entry will be freed since they were previously allocated
 // otherwise the new entry state is ENTRY_UNUSED in which case no alloc or frees happen here since that is the job of hashtable_put
-void hashtable_init_entry(Hashtable *ht, unsigned int entry_idx, EntryState state);
+HASHTABLE_API void hashtable_init_entry(Hashtable *ht, ht_index_t entry_idx, EntryState state);
 
-bool hashtable_put(Hashtable *ht, const void* key, void *value);
+HASHTABLE_API bool hashtable_put(Hashtable *ht, const void* key, void *value);
 
-void *hashtable_find(const Hashtable *ht, const void *key);
+HASHTABLE_API void *hashtable_find(const Hashtable *ht, const void *key);
 
-void hashtable_get(const Hashtable *ht, const void *key, void *out_value);
+HASHTABLE_API void hashtable_get(const Hashtable *ht, const void *key, void *out_value);
 
-bool hashtable_resize(Hashtable *ht, unsigned int desired_capacity);
+HASHTABLE_API bool hashtable_resize(Hashtable *ht, ht_index_t desired_capacity);
 
-bool hashtable_empty(const Hashtable *ht);
-unsigned int hashtable_count(const Hashtable *ht);
+HASHTABLE_API bool hashtable_empty(const Hashtable *ht);
+HASHTABLE_API ht_index_t hashtable_count(const Hashtable *ht);
 
-bool hashtable_contains(const Hashtable *ht, const void *key);
+HASHTABLE_API bool hashtable_contains(const Hashtable *ht, const void *key);
 
-void hashtable_remove(Hashtable *ht, const void *key);
+HASHTABLE_API void hashtable_remove(Hashtable *ht, const void *key);
 
-void hashtable_clear(Hashtable *ht);
+HASHTABLE_API void hashtable_clear(Hashtable *ht);
 
-float hashtable_load_factor(const Hashtable *ht);
+HASHTABLE_API float hashtable_load_factor(const Hashtable *ht);
 
 // _hashtable_destroy macro to keep the interface consistent
 // frees and NULLs all contained pointers keys, vals, table pointer itself
 // mirrors hashtable_create in reverse
 #define hashtable_destroy(ht_ptr) _hashtable_destroy(&ht_ptr);
-void _hashtable_destroy(Hashtable **ht);
+HASHTABLE_API void _hashtable_destroy(Hashtable **ht);
 
-ProbeResult probe_used_idx(
+HASHTABLE_API ProbeResult probe_used_idx(
     const Hashtable *ht,
     const void *key,
-    unsigned int *used_idx
+    ht_index_t *used_idx
 );
 
 /**
@@ -102,30 +403,202 @@ ProbeResult probe_used_idx(
  * Ultimately this function will return a PROBE_RESULT where KEY_FOUND means updating an existing slot/entry and NOT_FOUND means an unused but, 
  * soon to be in use slot.
  */
-ProbeResult probe_free_idx(
+HASHTABLE_API ProbeResult probe_free_idx(
     const Hashtable *ht,
     const void *key,
     const uint64_t key_hash,
-    const unsigned int start_idx,
-    unsigned int *out_idx
+    const ht_index_t start_idx,
+    ht_index_t *out_idx
 ); 
 
 
-// prints basic table stats: count, capacity, load factor // TODO: add memory usage counter here too
-void hashtable_stats(Hashtable *ht, char *message);
+// prints basic table stats: count, capacity, load factor, memory usage, plus the HTStats counters with HASHTABLE_STATS
+HASHTABLE_API void hashtable_stats(Hashtable *ht, char *message);
+
+// memory held by a table, the Hashtable struct itself is not included since it may live on the stack
+typedef struct HTMemoryUsage {
+    size_t entry_array_bytes; // capacity * sizeof(Hashentry)
+    size_t metadata_bytes; // occupancy bitmap and the HTStats block
+    size_t key_bytes; // count * key_size, as requested from malloc
+    size_t value_bytes; // count * value_size
+    size_t malloc_overhead_bytes; // allocator headers and size rounding of the per entry key/value mallocs
+    size_t empty_slot_bytes; // part of the entry array in ENTRY_UNUSED slots
+    size_t tombstone_slot_bytes; // part of the entry array in ENTRY_DELETED slots
+    size_t total_bytes; // entry array + metadata + keys + values + malloc overhead
+    double bytes_per_element; // total_bytes / count, 0 for an empty table
+    ht_index_t tombstones;
+} HTMemoryUsage;
+
+// walks every slot of malloc backed tables, O(capacity). With glibc the malloc overhead is measured with malloc_usable_size,
+// elsewhere it is estimated from a 16 byte aligned allocator with an 8 byte header and 32 byte minimum chunk.
+// Tables owning an arena report the arena's reserved chunks, other custom allocators are assumed to have none.
+HASHTABLE_API HTMemoryUsage hashtable_memory_usage(const Hashtable *ht);
+// O(1) hashtable_memory_usage from the counts alone, the malloc overhead is always the estimate above
+HASHTABLE_API HTMemoryUsage hashtable_memory_estimate(const Hashtable *ht);
+
+#ifdef HASHTABLE_STATS
+// copies the counters of ht into out
+HASHTABLE_API void hashtable_get_stats(const Hashtable *ht, HTStats *out);
+HASHTABLE_API void hashtable_reset_stats(Hashtable *ht);
+#endif
+
+#ifdef HASHTABLE_TRACE
+// logs every hashtable_put/find/remove/clear/resize call on ht to a trace file at path (format above) until
+// hashtable_trace_stop or hashtable_deinit. hashed_keys records 8 byte key hashes instead of the key bytes,
+// smaller for long keys and keeps key contents out of the file, replay then uses the hashes as keys.
+HASHTABLE_API bool hashtable_trace_start(Hashtable *ht, const char *path, bool hashed_keys);
+HASHTABLE_API void hashtable_trace_stop(Hashtable *ht);
+#endif
+
+#ifdef HASHTABLE_LATENCY
+// latency in ticks at or below which a fraction (0 to 1) of the recorded op calls completed, 0 when none were
+// recorded. The result is the upper bound of the histogram bucket, capped at the recorded max
+HASHTABLE_API uint64_t hashtable_latency_percentile(const Hashtable *ht, HTLatencyOp op, double fraction);
+HASHTABLE_API HTLatencySummary hashtable_latency_summary(const Hashtable *ht, HTLatencyOp op);
+HASHTABLE_API void hashtable_latency_reset(Hashtable *ht);
+// measured once over ~10ms against CLOCK_MONOTONIC, to convert ticks to nanoseconds
+HASHTABLE_API double hashtable_latency_ticks_per_ns(void);
+#endif
+
+HASHTABLE_API bool is_even(int x);
+// 0 when no prime >= x fits in ht_index_t
+HASHTABLE_API ht_index_t next_prime(ht_index_t x);
+// smallest capacity >= desired HT_PROBE_DEFAULT fully covers: a prime, = 3 mod 4 with QUAD_PROBING. 0 when none fits
+HASHTABLE_API ht_index_t hashtable_probe_capacity(ht_index_t desired);
+HASHTABLE_API bool is_prime(ht_index_t x);
+
+HASHTABLE_API uint64_t djb2(const void *key, size_t key_size);
+HASHTABLE_API uint64_t hashtable_hash_xxh64(const void *key, size_t key_size);
+HASHTABLE_API uint64_t hashtable_hash_xxh3(const void *key, size_t key_size);
+HASHTABLE_API uint64_t hashtable_hash_int(const void *key, size_t key_size);
+
+// selects the hash function of a table, custom is only used with HT_HASH_CUSTOM.
+// A non empty table is rehashed in place, an in progress hashtable_scan must be restarted afterwards.
+// Since home slots come from the high bits of the hash, djb2 and custom hashes are passed through
+// hashtable_mix64 before use.
+HASHTABLE_API bool hashtable_set_hash(Hashtable *ht, HTHashKind hash_kind, HTHashFunc custom);
 
-bool is_even(int x);
-unsigned int next_prime(unsigned int x);
-bool is_prime(unsigned int x);
+// selects the probe sequence of a table, new tables start with HT_PROBE_DEFAULT. The table is rebuilt at a
+// capacity the new sequence fully covers, an in progress hashtable_scan must be restarted afterwards.
+// hashtable_scan does not support HT_PROBE_DOUBLE tables.
+HASHTABLE_API bool hashtable_set_probe(Hashtable *ht, HTProbeStrategy strategy);
 
-uint64_t djb2(const void *key, size_t key_size);
+// number of slots examined to find key, 1 when it sits in its home slot, 0 when it isn't present
+HASHTABLE_API ht_index_t hashtable_probe_length(const Hashtable *ht, const void *key);
 
 
 typedef struct HTIterator {
-    unsigned int curr_idx;
-    const Hashtable *ht;
+    ht_index_t curr_idx;
+    Hashtable *ht;
 } HTIterator;
 
 
-const Hashentry* HTIterator_start(HTIterator *iterator, Hashtable *ht);
-const Hashentry* HTIterator_next(HTIterator *iterator);
\ No newline at end of file
+HASHTABLE_API const Hashentry* HTIterator_start(HTIterator *iterator, Hashtable *ht);
+HASHTABLE_API const Hashentry* HTIterator_next(HTIterator *iterator);
+// removes the entry most recently returned by HTIterator_start/next without re-hashing or probing its key,
+// iteration can continue with HTIterator_next afterwards. Returns false when there is no such entry.
+HASHTABLE_API bool HTIterator_erase(HTIterator *iterator);
+
+// keeps only the entries for which predicate returns true, filtering the whole table in one pass and
+// rebuilding it without tombstones afterwards. Returns the number of entries removed.
+typedef bool (*HTRetainPredicate)(const void *key, void *value, void *ctx);
+HASHTABLE_API ht_index_t hashtable_retain(Hashtable *ht, HTRetainPredicate predicate, void *ctx);
+
+// iterator over a contiguous range of slots [begin, end), ranges can be split to hand work to other threads
+typedef struct HTSlotRange {
+    const Hashtable *ht;
+    ht_index_t begin;
+    ht_index_t end;
+    ht_index_t curr_idx;
+} HTSlotRange;
+
+// end is clamped to the capacity, pass ht->capacity for the whole table
+HASHTABLE_API void HTSlotRange_init(HTSlotRange *range, const Hashtable *ht, ht_index_t begin, ht_index_t end);
+// moves the upper half of the slots not yet visited into upper, false when the range is too small to split
+HASHTABLE_API bool HTSlotRange_split(HTSlotRange *range, HTSlotRange *upper);
+HASHTABLE_API const Hashentry *HTSlotRange_next(HTSlotRange *range);
+
+/**
+ * Calls callback for every entry using nthreads threads (the caller included) that claim contiguous slot
+ * ranges from a shared queue. thread_idx is in [0, nthreads) and stable for a thread during the call,
+ * callers wanting a reduction keep one accumulator per thread_idx in ctx and combine them afterwards.
+ * The table must not be modified until hashtable_foreach_parallel returns.
+ */
+typedef void (*HTForeachCallback)(const Hashentry *entry, unsigned int thread_idx, void *ctx);
+HASHTABLE_API bool hashtable_foreach_parallel(const Hashtable *ht, HTForeachCallback callback, void *ctx, unsigned int nthreads);
+
+/**
+ * Resize stable incremental traversal, similar to Redis SCAN.
+ * The cursor is a position in hash order: start with 0 and pass each returned cursor to the next call
+ * until 0 is returned. Each call walks at most bucket_count home buckets and calls callback with their entries.
+ * Only the number of buckets is bounded, not the work: a bucket is walked along its probe sequence up to the
+ * first unused slot, so a long run of used or tombstone slots can make a single call O(capacity). A rebuild
+ * (hashtable_resize, hashtable_retain) drops the tombstones.
+ * Since home slots follow hash order for every capacity, the table may be modified and resized between calls
+ * and every entry present for the whole scan is still visited exactly once, entries added or removed during
+ * the scan may or may not be visited. The table must not be modified from inside the callback.
+ * Not available on HT_PROBE_DOUBLE tables, where entries sharing a home bucket each have their own stride:
+ * it returns 0 without calling callback, iterate those with HTIterator.
+ */
+typedef void (*HTScanCallback)(const Hashentry *entry, void *ctx);
+HASHTABLE_API uint64_t hashtable_scan(const Hashtable *ht, uint64_t cursor, unsigned int bucket_count, HTScanCallback callback, void *ctx);
+
+
+// Set mode: a Hashtable with value_size 0, only keys are stored and no value memory is allocated.
+// The generic hashtable_* functions work on sets too, put takes a NULL value and find returns the stored key.
+#define hashtableset_create(key_type, new_cap) _hashtable_create(sizeof(key_type), 0, new_cap);
+HASHTABLE_API bool hashtableset_init(Hashtable *set, const size_t key_size, const ht_index_t base_capacity);
+HASHTABLE_API bool hashtableset_insert(Hashtable *set, const void *key);
+HASHTABLE_API bool hashtableset_contains(const Hashtable *set, const void *key);
+// returns true if the key was present and removed
+HASHTABLE_API bool hashtableset_erase(Hashtable *set, const void *key);
+
+// bulk set operations, the table is grown once upfront instead of on each insert
+// keys points to key_count contiguous keys of set->key_size bytes each
+HASHTABLE_API bool hashtableset_insert_all(Hashtable *set, const void *keys, size_t key_count);
+// the set operations return false without modifying dst unless both are sets with the same key_size
+// dst = dst | src
+HASHTABLE_API bool hashtableset_union(Hashtable *dst, const Hashtable *src);
+// dst = dst & other
+HASHTABLE_API bool hashtableset_intersect(Hashtable *dst, const Hashtable *other);
+// dst = dst - other
+HASHTABLE_API bool hashtableset_difference(Hashtable *dst, const Hashtable *other);
+
+
+// Multimap mode: duplicate keys are allowed, hashtable_put always adds a new entry and the entries
+// sharing a key sit along that key's probe sequence. hashtable_find/get/remove act on the first match,
+// the functions below walk every match.
+#define hashtable_create_multimap(key_type, val_type, new_cap) _hashtable_create_multimap(sizeof(key_type), sizeof(val_type), new_cap);
+HASHTABLE_API struct Hashtable *_hashtable_create_multimap(size_t key_size, size_t value_size, ht_index_t new_cap);
+HASHTABLE_API bool hashtable_init_multimap(Hashtable *ht, const size_t key_size, const size_t value_size, const ht_index_t base_capacity);
+
+// iterator over every entry matching a single key, the hash is computed once for the whole walk
+typedef struct HTEqualRange {
+    const Hashtable *ht;
+    const void *key;
+    uint64_t key_hash;
+    ht_index_t start_idx;
+    ht_index_t curr_idx;
+    ht_index_t x; // probe number of curr_idx
+    ht_index_t stride; // probe_stride of key_hash
+} HTEqualRange;
+
+HASHTABLE_API const Hashentry *HTEqualRange_start(HTEqualRange *range, const Hashtable *ht, const void *key);
+HASHTABLE_API const Hashentry *HTEqualRange_next(HTEqualRange *range);
+
+// called with each value matching the key, returning false stops the walk
+typedef bool (*HTFindAllCallback)(void *value, void *ctx);
+
+// calls callback (may be NULL) for every value stored under key, returns the number of matches visited
+HASHTABLE_API ht_index_t hashtable_find_all(const Hashtable *ht, const void *key, HTFindAllCallback callback, void *ctx);
+HASHTABLE_API ht_index_t hashtable_count_key(const Hashtable *ht, const void *key);
+// removes every entry stored under key, returns how many were removed
+HASHTABLE_API ht_index_t hashtable_remove_all(Hashtable *ht, const void *key);
+
+#ifdef __cplusplus
+}
+#endif
+
+#if defined(HASHTABLE_IMPLEMENTATION) || defined(HASHTABLE_INLINE_ALL)
+#include "hashtable.c"
+#endif
@@ -0,0 +1,417 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+#include "hashtable.h"
+
+/**
+ * C++ wrapper following the core Hashtable design: open addressing over a prime capacity, the same
+ * probe_idx sequence, tombstones on erase and growth once TARGET_LOAD_FACTOR is reached.
+ *
+ * Unlike the C core, entries hold a std::pair<const K, V> constructed in place inside the slot array,
+ * so values may be move only and are never memcpy'd, and no per entry allocations take place.
+ * The interface mirrors std::unordered_map closely enough to be benchmarked against it directly:
+ * try_emplace, insert_or_assign, operator[], find/contains/count, erase and range-for iteration.
+ *
+ * Heterogeneous lookup is enabled when both Hash and Eq declare an is_transparent member type.
+ * Iterators and references are invalidated by any insertion that grows the table, erase only
+ * invalidates the erased element. A moved-from map is empty with no slots and allocates on its next insert.
+ * Growing past the largest capacity ht_index_t can hold throws std::length_error.
+ *
+ * Needs hashtable.c linked in (or HASHTABLE_IMPLEMENTATION in one C translation unit) for hashtable_probe_capacity.
+ */
+namespace flat_hash_map_detail {
+template <class T, class = void>
+struct is_transparent : std::false_type {};
+template <class T>
+struct is_transparent<T, std::void_t<typename T::is_transparent>> : std::true_type {};
+} // namespace flat_hash_map_detail
+
+template <class K, class V, class Hash = std::hash<K>, class Eq = std::equal_to<K>>
+class FlatHashMap {
+public:
+    using key_type = K;
+    using mapped_type = V;
+    using value_type = std::pair<const K, V>;
+    using size_type = std::size_t;
+    using hasher = Hash;
+    using key_equal = Eq;
+    using reference = value_type &;
+    using const_reference = const value_type &;
+
+private:
+    struct Slot {
+        uint64_t stored_hash;
+        EntryState state;
+        alignas(value_type) unsigned char storage[sizeof(value_type)];
+
+        value_type *ptr() { return std::launder(reinterpret_cast<value_type *>(storage)); }
+        const value_type *ptr() const { return std::launder(reinterpret_cast<const value_type *>(storage)); }
+    };
+
+    // Q keeps the condition dependent so it is checked per call rather than on class instantiation
+    template <class Q>
+    using enable_if_transparent = std::enable_if_t<flat_hash_map_detail::is_transparent<Hash>::value &&
+                                                   flat_hash_map_detail::is_transparent<Eq>::value &&
+                                                   !std::is_same_v<Q, void>>;
+
+    static constexpr size_type npos = static_cast<size_type>(-1);
+
+public:
+    template <bool Const>
+    class basic_iterator {
+        friend class FlatHashMap;
+        using slot_ptr = std::conditional_t<Const, const Slot *, Slot *>;
+        slot_ptr curr = nullptr;
+        slot_ptr end = nullptr;
+
+        basic_iterator(slot_ptr curr, slot_ptr end) : curr(curr), end(end) { skip_unused(); }
+        void skip_unused() {
+            while (curr != end && curr->state != ENTRY_USED) {
+                ++curr;
+            }
+        }
+
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = FlatHashMap::value_type;
+        using difference_type = std::ptrdiff_t;
+        using reference = std::conditional_t<Const, const value_type &, value_type &>;
+        using pointer = std::conditional_t<Const, const value_type *, value_type *>;
+
+        basic_iterator() = default;
+        // iterator converts to const_iterator
+        template <bool C = Const, class = std::enable_if_t<C>>
+        basic_iterator(const basic_iterator<false> &other) : curr(other.curr), end(other.end) {}
+
+        reference operator*() const { return *curr->ptr(); }
+        pointer operator->() const { return curr->ptr(); }
+        basic_iterator &operator++() {
+            ++curr;
+            skip_unused();
+            return *this;
+        }
+        basic_iterator operator++(int) {
+            basic_iterator prev = *this;
+            ++*this;
+            return prev;
+        }
+        friend bool operator==(const basic_iterator &a, const basic_iterator &b) { return a.curr == b.curr; }
+        friend bool operator!=(const basic_iterator &a, const basic_iterator &b) { return a.curr != b.curr; }
+    };
+    using iterator = basic_iterator<false>;
+    using const_iterator = basic_iterator<true>;
+
+    explicit FlatHashMap(size_type base_capacity = 16, const Hash &hash = Hash(), const Eq &eq = Eq())
+        : hash_(hash), eq_(eq) {
+        allocate(base_capacity < 2 ? 2 : base_capacity);
+    }
+
+    FlatHashMap(const FlatHashMap &other) : hash_(other.hash_), eq_(other.eq_) {
+        if (other.capacity_ > 0) {
+            allocate(other.capacity_);
+        }
+        for (const value_type &kv : other) {
+            try_emplace(kv.first, kv.second);
+        }
+    }
+
+    FlatHashMap(FlatHashMap &&other) noexcept
+        : arr_(std::move(other.arr_)), capacity_(other.capacity_), count_(other.count_),
+          hash_(std::move(other.hash_)), eq_(std::move(other.eq_)) {
+        other.capacity_ = 0;
+        other.count_ = 0;
+    }
+
+    FlatHashMap &operator=(FlatHashMap other) noexcept {
+        swap(other);
+        return *this;
+    }
+
+    ~FlatHashMap() { destroy_all(); }
+
+    void swap(FlatHashMap &other) noexcept {
+        using std::swap;
+        swap(arr_, other.arr_);
+        swap(capacity_, other.capacity_);
+        swap(count_, other.count_);
+        swap(hash_, other.hash_);
+        swap(eq_, other.eq_);
+    }
+
+    size_type size() const { return count_; }
+    bool empty() const { return count_ == 0; }
+    size_type capacity() const { return capacity_; }
+    float load_factor() const { return capacity_ ? static_cast<float>(count_) / capacity_ : 0.0f; }
+
+    iterator begin() { return iterator(arr_.get(), arr_.get() + capacity_); }
+    iterator end() { return iterator(arr_.get() + capacity_, arr_.get() + capacity_); }
+    const_iterator begin() const { return const_iterator(arr_.get(), arr_.get() + capacity_); }
+    const_iterator end() const { return const_iterator(arr_.get() + capacity_, arr_.get() + capacity_); }
+    const_iterator cbegin() const { return begin(); }
+    const_iterator cend() const { return end(); }
+
+    // constructs V from args in place only if key is not present, args are left untouched otherwise
+    template <class... Args>
+    std::pair<iterator, bool> try_emplace(const K &key, Args &&...args) {
+        return emplace_impl(key, std::forward<Args>(args)...);
+    }
+    template <class... Args>
+    std::pair<iterator, bool> try_emplace(K &&key, Args &&...args) {
+        return emplace_impl(std::move(key), std::forward<Args>(args)...);
+    }
+
+    template <class M>
+    std::pair<iterator, bool> insert_or_assign(const K &key, M &&value) {
+        auto res = try_emplace(key, std::forward<M>(value));
+        if (!res.second) {
+            res.first->second = std::forward<M>(value);
+        }
+        return res;
+    }
+    template <class M>
+    std::pair<iterator, bool> insert_or_assign(K &&key, M &&value) {
+        auto res = try_emplace(std::move(key), std::forward<M>(value));
+        if (!res.second) {
+            res.first->second = std::forward<M>(value);
+        }
+        return res;
+    }
+
+    std::pair<iterator, bool> insert(const value_type &kv) { return try_emplace(kv.first, kv.second); }
+    std::pair<iterator, bool> insert(value_type &&kv) { return try_emplace(kv.first, std::move(kv.second)); }
+
+    V &operator[](const K &key) { return try_emplace(key).first->second; }
+    V &operator[](K &&key) { return try_emplace(std::move(key)).first->second; }
+
+    V &at(const K &key) {
+        iterator it = find(key);
+        if (it == end()) {
+            throw std::out_of_range("FlatHashMap::at key not found");
+        }
+        return it->second;
+    }
+    const V &at(const K &key) const {
+        const_iterator it = find(key);
+        if (it == end()) {
+            throw std::out_of_range("FlatHashMap::at key not found");
+        }
+        return it->second;
+    }
+
+    iterator find(const K &key) { return iterator_at(probe_used_idx(key)); }
+    const_iterator find(const K &key) const { return iterator_at(probe_used_idx(key)); }
+    template <class Q, class = enable_if_transparent<Q>>
+    iterator find(const Q &key) { return iterator_at(probe_used_idx(key)); }
+    template <class Q, class = enable_if_transparent<Q>>
+    const_iterator find(const Q &key) const { return iterator_at(probe_used_idx(key)); }
+
+    bool contains(const K &key) const { return probe_used_idx(key) != npos; }
+    template <class Q, class = enable_if_transparent<Q>>
+    bool contains(const Q &key) const { return probe_used_idx(key) != npos; }
+
+    size_type count(const K &key) const { return contains(key) ? 1 : 0; }
+    template <class Q, class = enable_if_transparent<Q>>
+    size_type count(const Q &key) const { return contains(key) ? 1 : 0; }
+
+    size_type erase(const K &key) { return erase_idx(probe_used_idx(key)); }
+    // iterators are excluded like std::unordered_map does, otherwise erase(it) on a non const iterator would pick
+    // this exact match over erase(const_iterator)
+    template <class Q, class = enable_if_transparent<Q>,
+              class = std::enable_if_t<!std::is_convertible_v<Q, iterator> && !std::is_convertible_v<Q, const_iterator>>>
+    size_type erase(const Q &key) { return erase_idx(probe_used_idx(key)); }
+
+    // erases the element pointed at, returns the iterator to the next element
+    iterator erase(const_iterator pos) {
+        size_type idx = static_cast<size_type>(pos.curr - arr_.get());
+        erase_idx(idx);
+        return iterator(arr_.get() + idx + 1, arr_.get() + capacity_);
+    }
+
+    void clear() {
+        for (size_type i = 0; i < capacity_; i++) {
+            if (arr_[i].state == ENTRY_USED) {
+                arr_[i].ptr()->~value_type();
+            }
+            arr_[i].state = ENTRY_UNUSED;
+        }
+        count_ = 0;
+    }
+
+    // rebuilds the table with at least desired_capacity slots, see hashtable_resize
+    bool rehash(size_type desired_capacity) {
+        if (desired_capacity < 2 || static_cast<float>(count_) / desired_capacity >= TARGET_LOAD_FACTOR) {
+            return false;
+        }
+        FlatHashMap grown(desired_capacity, hash_, eq_);
+        for (size_type i = 0; i < capacity_; i++) {
+            Slot &old_slot = arr_[i];
+            if (old_slot.state != ENTRY_USED) {
+                continue;
+            }
+            size_type idx = grown.probe_free_idx(old_slot.ptr()->first, old_slot.stored_hash);
+            Slot &slot = grown.arr_[idx];
+            // keys are const inside the pair, moving the whole pair still moves V
+            new (slot.storage) value_type(std::move(*old_slot.ptr()));
+            slot.stored_hash = old_slot.stored_hash;
+            slot.state = ENTRY_USED;
+            grown.count_++;
+        }
+        swap(grown);
+        return true;
+    }
+
+    void reserve(size_type count) {
+        size_type desired = static_cast<size_type>(count / TARGET_LOAD_FACTOR) + 1;
+        if (desired > capacity_) {
+            rehash(desired);
+        }
+    }
+
+private:
+    std::unique_ptr<Slot[]> arr_;
+    size_type capacity_ = 0;
+    size_type count_ = 0;
+    Hash hash_;
+    Eq eq_;
+
+    void allocate(size_type desired_capacity) {
+        ht_index_t capacity = desired_capacity > HT_INDEX_MAX ? 0 : hashtable_probe_capacity(static_cast<ht_index_t>(desired_capacity));
+        if (capacity == 0) {
+            throw std::length_error("FlatHashMap capacity exceeds the ht_index_t limit");
+        }
+        arr_.reset(new Slot[capacity]);
+        capacity_ = capacity;
+        for (size_type i = 0; i < capacity_; i++) {
+            arr_[i].state = ENTRY_UNUSED;
+        }
+    }
+
+    // doubles the capacity, a moved-from map gets its first slots
+    void grow() {
+        if (!rehash(capacity_ > 0 ? 2 * capacity_ : 2)) {
+            throw std::length_error("FlatHashMap unable to grow");
+        }
+    }
+
+    void destroy_all() {
+        if (!arr_) {
+            return;
+        }
+        if constexpr (!std::is_trivially_destructible_v<value_type>) {
+            for (size_type i = 0; i < capacity_; i++) {
+                if (arr_[i].state == ENTRY_USED) {
+                    arr_[i].ptr()->~value_type();
+                }
+            }
+        }
+    }
+
+    template <class Q>
+    uint64_t hash_key(const Q &key) const {
+        // std::hash is the identity for integers, mix it so home_idx sees entropy in the high bits
+        return hashtable_mix64(static_cast<uint64_t>(hash_(key)));
+    }
+
+    size_type next_idx(size_type start_idx, ht_index_t x) const {
+        return probe_idx(static_cast<ht_index_t>(start_idx), x, static_cast<ht_index_t>(capacity_));
+    }
+
+    iterator iterator_at(size_type idx) {
+        return idx == npos ? end() : iterator(arr_.get() + idx, arr_.get() + capacity_);
+    }
+    const_iterator iterator_at(size_type idx) const {
+        return idx == npos ? end() : const_iterator(arr_.get() + idx, arr_.get() + capacity_);
+    }
+
+    // mirrors probe_used_idx, npos when the key is not present
+    template <class Q>
+    size_type probe_used_idx(const Q &key) const {
+        if (count_ == 0) {
+            return npos;
+        }
+        uint64_t key_hash = hash_key(key);
+        size_type start_idx = home_idx(key_hash, static_cast<ht_index_t>(capacity_));
+        size_type curr_idx = start_idx;
+        for (ht_index_t x = 1; x <= capacity_; x++) {
+            const Slot &slot = arr_[curr_idx];
+            if (slot.state == ENTRY_UNUSED) {
+                return npos;
+            }
+            if (slot.state == ENTRY_USED && slot.stored_hash == key_hash && eq_(slot.ptr()->first, key)) {
+                return curr_idx;
+            }
+            curr_idx = next_idx(start_idx, x);
+        }
+        return npos;
+    }
+
+    // mirrors probe_free_idx: the index of key if present (*found set), otherwise the slot to insert
+    // into preferring the first tombstone, npos when the probe sequence is exhausted or there are no slots
+    size_type probe_free_idx(const K &key, uint64_t key_hash, bool *found = nullptr) const {
+        if (capacity_ == 0) {
+            return npos;
+        }
+        size_type start_idx = home_idx(key_hash, static_cast<ht_index_t>(capacity_));
+        size_type curr_idx = start_idx;
+        size_type first_deleted_idx = npos;
+        for (ht_index_t x = 1; x <= capacity_; x++) {
+            const Slot &slot = arr_[curr_idx];
+            if (slot.state == ENTRY_UNUSED) {
+                return first_deleted_idx != npos ? first_deleted_idx : curr_idx;
+            }
+            if (slot.state == ENTRY_DELETED) {
+                if (first_deleted_idx == npos) {
+                    first_deleted_idx = curr_idx;
+                }
+            } else if (found && slot.stored_hash == key_hash && eq_(slot.ptr()->first, key)) {
+                *found = true;
+                return curr_idx;
+            }
+            curr_idx = next_idx(start_idx, x);
+        }
+        return first_deleted_idx;
+    }
+
+    template <class KArg, class... Args>
+    std::pair<iterator, bool> emplace_impl(KArg &&key, Args &&...args) {
+        uint64_t key_hash = hash_key(key);
+        bool found = false;
+        size_type idx = probe_free_idx(key, key_hash, &found);
+        // an existing key never grows the table, so its iterators stay valid
+        if (found) {
+            return {iterator_at(idx), false};
+        }
+        // grow at the load factor or on an exhausted probe sequence like hashtable_put does, grow throws
+        // when it can't so this ends
+        while (idx == npos || static_cast<float>(count_ + 1) / capacity_ >= TARGET_LOAD_FACTOR) {
+            grow();
+            idx = probe_free_idx(key, key_hash);
+        }
+        Slot &slot = arr_[idx];
+        new (slot.storage) value_type(std::piecewise_construct, std::forward_as_tuple(std::forward<KArg>(key)),
+                                      std::forward_as_tuple(std::forward<Args>(args)...));
+        slot.stored_hash = key_hash;
+        slot.state = ENTRY_USED;
+        count_++;
+        return {iterator_at(idx), true};
+    }
+
+    size_type erase_idx(size_type idx) {
+        if (idx == npos) {
+            return 0;
+        }
+        arr_[idx].ptr()->~value_type();
+        arr_[idx].state = ENTRY_DELETED;
+        count_--;
+        return 1;
+    }
+};
@@ -0,0 +1,681 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
+
+#include "hashtable.h"
+
+/**
+ * Benchmark driver for the Hashtable core, results are written as CSV (one row per workload phase).
+ *
+ * Phases: put into an empty table pre-sized for the load factor, find hits, find misses, full iteration,
+ * a single resize to twice the capacity and remove of every key. Throughput covers the whole phase,
+ * latency percentiles come from timing every LATENCY_SAMPLE_EVERY-th operation individually.
+ *
+ * The default probing mode is compile time (QUAD_PROBING), `make bench` builds hashtable_bench_linear and
+ * hashtable_bench_quad from this file. The hash function and probe strategy are per table
+ * (hashtable_set_hash, hashtable_set_probe), --hashes and --probes run every workload once per listed
+ * hash and strategy, the strategies sharing one key set.
+ *
+ * usage: hashtable_bench [--quick] [--sizes n,n,..] [--key-sizes b,b,..] [--load-factors f,f,..]
+ *                        [--dists uniform,zipf,sequential] [--hashes xxh64,xxh3,int,djb2]
+ *                        [--probes linear,quadratic,double]
+ *                        [--ops n] [--seed n] [--perf] [--arena] [--csv path]
+ * Without --sizes, table sizes are picked so the table footprint spans L1 to 10x the last level cache.
+ * --arena builds every table with hashtable_init_arena so keys and values come from a slab arena.
+ *
+ * --perf wraps every phase in perf_event_open hardware counters (cycles, instructions, L1D/LLC/dTLB load
+ * misses, branch misses, user space only) and adds their per operation averages to the CSV. Latency sampling
+ * is turned off with --perf so the clock reads don't show up in the counts, the percentile columns are 0.
+ * Counters the CPU or VM doesn't expose are left empty.
+ *
+ *        hashtable_bench --hash-bench keys.bin --key-sizes b [--load-factors f] [--hashes ..] [--probes ..]
+ *                        [--csv path]
+ * reads keys.bin as back to back b byte keys and reports, per hash, its throughput over the key set
+ * and the probe length distribution of the keys once inserted into a table at load factor f.
+ */
+
+#define LATENCY_SAMPLE_EVERY 8
+#define MAX_LIST 16
+#define ZIPF_THETA 0.99
+
+typedef enum BenchDist {
+    DIST_UNIFORM,
+    DIST_ZIPF,
+    DIST_SEQUENTIAL
+} BenchDist;
+
+static const char *dist_names[] = {"uniform", "zipf", "sequential"};
+
+// indexed by HTHashKind, HT_HASH_CUSTOM has nothing to benchmark
+static const char *hash_names[] = {"xxh64", "xxh3", "int", "djb2"};
+static const HTHashFunc hash_funcs[] = {hashtable_hash_xxh64, hashtable_hash_xxh3, hashtable_hash_int, djb2};
+
+// indexed by HTProbeStrategy
+static const char *probe_names[] = {"linear", "quadratic", "double"};
+
+#define PERF_EVENTS 6
+
+static const char *perf_names[PERF_EVENTS] = {
+    "cycles", "instructions", "l1d_misses", "llc_misses", "dtlb_misses", "branch_misses"
+};
+
+// one perf_event fd per counter, opened individually so a counter the PMU lacks doesn't disable the rest
+typedef struct BenchPerf {
+    int fds[PERF_EVENTS]; // -1 when unavailable
+    double deltas[PERF_EVENTS]; // counts of the last phase, scaled up when the kernel multiplexed the counter
+} BenchPerf;
+
+typedef struct BenchConfig {
+    size_t sizes[MAX_LIST];
+    unsigned int size_count;
+    size_t key_sizes[MAX_LIST];
+    unsigned int key_size_count;
+    double load_factors[MAX_LIST];
+    unsigned int load_factor_count;
+    BenchDist dists[MAX_LIST];
+    unsigned int dist_count;
+    HTHashKind hashes[MAX_LIST];
+    unsigned int hash_count;
+    HTProbeStrategy probes[MAX_LIST];
+    unsigned int probe_count;
+    const char *hash_bench_path; // key file for --hash-bench, NULL runs the table workloads
+    size_t ops; // lookups per find phase, 0 means one per element
+    uint64_t seed;
+    bool quick;
+    bool arena; // hashtable_init_arena instead of per entry malloc
+    BenchPerf *perf; // NULL unless --perf
+    FILE *csv;
+} BenchConfig;
+
+// one workload: the key set, the access order and the sampled latencies of the current phase
+typedef struct BenchWorkload {
+    size_t n;
+    size_t key_size;
+    double load_factor;
+    BenchDist dist;
+    HTHashKind hash;
+    HTProbeStrategy probe;
+    unsigned char *keys; // n keys, present in the table
+    unsigned char *miss_keys; // n keys, never inserted
+    size_t *access; // ops indexes into keys/miss_keys in access order
+    size_t ops;
+    uint64_t *samples;
+    size_t sample_count;
+    bool sampling; // latency sampling, off while hardware counters run
+    BenchPerf *perf;
+} BenchWorkload;
+
+static inline uint64_t bench_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static inline uint64_t splitmix64(uint64_t *state) {
+    uint64_t z = (*state += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+static inline double rand_unit(uint64_t *state) {
+    return (splitmix64(state) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+// YCSB style zipfian generator over [0, n)
+typedef struct Zipf {
+    size_t n;
+    double zetan;
+    double alpha;
+    double eta;
+} Zipf;
+
+static void zipf_init(Zipf *z, size_t n) {
+    double zeta2 = 1.0 + pow(0.5, ZIPF_THETA);
+    z->n = n;
+    z->zetan = 0;
+    for (size_t i = 1; i <= n; i++) {
+        z->zetan += 1.0 / pow((double)i, ZIPF_THETA);
+    }
+    z->alpha = 1.0 / (1.0 - ZIPF_THETA);
+    z->eta = (1.0 - pow(2.0 / n, 1.0 - ZIPF_THETA)) / (1.0 - zeta2 / z->zetan);
+}
+
+static size_t zipf_next(const Zipf *z, uint64_t *state) {
+    double u = rand_unit(state);
+    double uz = u * z->zetan;
+    if (uz < 1.0) return 0;
+    if (uz < 1.0 + pow(0.5, ZIPF_THETA)) return 1;
+    size_t rank = (size_t)(z->n * pow(z->eta * u - z->eta + 1.0, z->alpha));
+    return rank < z->n ? rank : z->n - 1;
+}
+
+static inline uint32_t mix32(uint32_t x) {
+    x ^= x >> 16;
+    x *= 0x85ebca6bu;
+    x ^= x >> 13;
+    x *= 0xc2b2ae35u;
+    x ^= x >> 16;
+    return x;
+}
+
+// writes key number i: its integer in the first bytes, the remaining bytes derived from it.
+// Both mixers are bijections so distinct i always give distinct keys, even for 4 byte keys
+static void make_key(unsigned char *out, size_t key_size, uint64_t i, BenchDist dist) {
+    uint64_t word = i;
+    if (dist != DIST_SEQUENTIAL) {
+        word = key_size < sizeof(uint64_t) ? mix32((uint32_t)i) : hashtable_mix64(i);
+    }
+    for (size_t off = 0; off < key_size; off += sizeof(uint64_t)) {
+        size_t len = key_size - off < sizeof(uint64_t) ? key_size - off : sizeof(uint64_t);
+        memcpy(out + off, &word, len);
+        word = hashtable_mix64(word + off + 1);
+    }
+}
+
+static bool workload_init(BenchWorkload *w, const BenchConfig *cfg, size_t n, size_t key_size, double lf, BenchDist dist, HTHashKind hash) {
+    memset(w, 0, sizeof(*w));
+    w->n = n;
+    w->key_size = key_size;
+    w->load_factor = lf;
+    w->dist = dist;
+    w->hash = hash;
+    w->perf = cfg->perf;
+    w->sampling = !cfg->perf;
+    w->ops = cfg->ops ? cfg->ops : n;
+    w->keys = (unsigned char *)malloc(n * key_size);
+    w->miss_keys = (unsigned char *)malloc(n * key_size);
+    w->access = (size_t *)malloc(w->ops * sizeof(size_t));
+    w->samples = (uint64_t *)malloc((w->ops / LATENCY_SAMPLE_EVERY + n / LATENCY_SAMPLE_EVERY + 2) * sizeof(uint64_t));
+    if (!w->keys || !w->miss_keys || !w->access || !w->samples) {
+        fprintf(stderr, "failed to allocate benchmark workload for %zu keys\n", n);
+        return false;
+    }
+    // 4 byte keys can only hold 2^32 distinct sequential values, offsetting misses keeps them disjoint
+    for (size_t i = 0; i < n; i++) {
+        make_key(w->keys + i * key_size, key_size, i, dist);
+        make_key(w->miss_keys + i * key_size, key_size, i + n, dist);
+    }
+    uint64_t rng = cfg->seed;
+    Zipf zipf;
+    if (dist == DIST_ZIPF) {
+        zipf_init(&zipf, n);
+    }
+    for (size_t i = 0; i < w->ops; i++) {
+        switch (dist) {
+        case DIST_SEQUENTIAL: w->access[i] = i % n; break;
+        case DIST_ZIPF: w->access[i] = zipf_next(&zipf, &rng); break;
+        case DIST_UNIFORM:
+        default: w->access[i] = splitmix64(&rng) % n; break;
+        }
+    }
+    return true;
+}
+
+static void workload_deinit(BenchWorkload *w) {
+    free(w->keys);
+    free(w->miss_keys);
+    free(w->access);
+    free(w->samples);
+}
+
+#ifdef __linux__
+static int perf_open_event(uint32_t type, uint64_t config) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+#define PERF_CACHE_READ_MISS(cache) \
+    ((cache) | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16))
+
+// returns false when no counter at all could be opened (no PMU, perf_event_paranoid too strict)
+static bool perf_open(BenchPerf *perf) {
+    perf->fds[0] = perf_open_event(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+    perf->fds[1] = perf_open_event(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+    perf->fds[2] = perf_open_event(PERF_TYPE_HW_CACHE, PERF_CACHE_READ_MISS(PERF_COUNT_HW_CACHE_L1D));
+    perf->fds[3] = perf_open_event(PERF_TYPE_HW_CACHE, PERF_CACHE_READ_MISS(PERF_COUNT_HW_CACHE_LL));
+    perf->fds[4] = perf_open_event(PERF_TYPE_HW_CACHE, PERF_CACHE_READ_MISS(PERF_COUNT_HW_CACHE_DTLB));
+    perf->fds[5] = perf_open_event(PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES);
+    bool any = false;
+    for (int i = 0; i < PERF_EVENTS; i++) {
+        any |= perf->fds[i] >= 0;
+    }
+    return any;
+}
+
+static void perf_close(BenchPerf *perf) {
+    for (int i = 0; i < PERF_EVENTS; i++) {
+        if (perf->fds[i] >= 0) close(perf->fds[i]);
+    }
+}
+
+static void perf_start(BenchPerf *perf) {
+    if (!perf) return;
+    for (int i = 0; i < PERF_EVENTS; i++) {
+        if (perf->fds[i] < 0) continue;
+        ioctl(perf->fds[i], PERF_EVENT_IOC_RESET, 0);
+        ioctl(perf->fds[i], PERF_EVENT_IOC_ENABLE, 0);
+    }
+}
+
+static void perf_stop(BenchPerf *perf) {
+    if (!perf) return;
+    for (int i = 0; i < PERF_EVENTS; i++) {
+        if (perf->fds[i] >= 0) ioctl(perf->fds[i], PERF_EVENT_IOC_DISABLE, 0);
+    }
+    for (int i = 0; i < PERF_EVENTS; i++) {
+        uint64_t values[3]; // count, time enabled, time running
+        perf->deltas[i] = -1;
+        if (perf->fds[i] >= 0 && read(perf->fds[i], values, sizeof(values)) == (ssize_t)sizeof(values) && values[2] > 0) {
+            perf->deltas[i] = (double)values[0] * ((double)values[1] / (double)values[2]);
+        }
+    }
+}
+#else
+static bool perf_open(BenchPerf *perf) {
+    (void)perf;
+    return false;
+}
+static void perf_close(BenchPerf *perf) { (void)perf; }
+static void perf_start(BenchPerf *perf) { (void)perf; }
+static void perf_stop(BenchPerf *perf) { (void)perf; }
+#endif
+
+static int compare_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+static uint64_t percentile(const uint64_t *sorted, size_t count, double p) {
+    if (count == 0) return 0;
+    size_t idx = (size_t)(p * (count - 1) + 0.5);
+    return sorted[idx];
+}
+
+static void report(const BenchConfig *cfg, BenchWorkload *w, const char *op, size_t ops, uint64_t total_ns) {
+    qsort(w->samples, w->sample_count, sizeof(uint64_t), compare_u64);
+    double ns_per_op = ops ? (double)total_ns / ops : 0;
+    fprintf(cfg->csv, "%s,%s,%zu,%zu,%.2f,%s,%s,%zu,%llu,%.3f,%.2f,%llu,%llu,%llu,%llu,%llu",
+            probe_names[w->probe], hash_names[w->hash], w->n, w->key_size, w->load_factor, dist_names[w->dist], op, ops,
+            (unsigned long long)total_ns, ns_per_op > 0 ? 1000.0 / ns_per_op : 0, ns_per_op,
+            (unsigned long long)percentile(w->samples, w->sample_count, 0.50),
+            (unsigned long long)percentile(w->samples, w->sample_count, 0.90),
+            (unsigned long long)percentile(w->samples, w->sample_count, 0.99),
+            (unsigned long long)percentile(w->samples, w->sample_count, 0.999),
+            (unsigned long long)(w->sample_count ? w->samples[w->sample_count - 1] : 0));
+    if (w->perf) {
+        // per operation counter averages, empty when a counter is unavailable
+        for (int i = 0; i < PERF_EVENTS; i++) {
+            if (w->perf->deltas[i] >= 0 && ops > 0) {
+                fprintf(cfg->csv, ",%.3f", w->perf->deltas[i] / ops);
+            } else {
+                fprintf(cfg->csv, ",");
+            }
+        }
+    }
+    fprintf(cfg->csv, "\n");
+    fflush(cfg->csv);
+    w->sample_count = 0;
+}
+
+// times op(i) for i in [0, count), sampling individual latencies, returns the phase duration
+#define BENCH_PHASE(w, count, op_expr) __extension__ ({ \
+    perf_start((w)->perf); \
+    uint64_t phase_start = bench_now_ns(); \
+    for (size_t i = 0; i < (count); i++) { \
+        if ((w)->sampling && i % LATENCY_SAMPLE_EVERY == 0) { \
+            uint64_t op_start = bench_now_ns(); \
+            op_expr; \
+            (w)->samples[(w)->sample_count++] = bench_now_ns() - op_start; \
+        } else { \
+            op_expr; \
+        } \
+    } \
+    uint64_t phase_ns = bench_now_ns() - phase_start; \
+    perf_stop((w)->perf); \
+    phase_ns; \
+})
+
+static volatile uint64_t bench_sink; // keeps lookups from being optimized away
+
+static void run_workload(const BenchConfig *cfg, BenchWorkload *w) {
+    const size_t ks = w->key_size;
+    Hashtable ht;
+    // pre-size so the table sits at the requested load factor once every key is in
+    ht_index_t capacity = (ht_index_t)(w->n / w->load_factor) + 1;
+    bool ok = cfg->arena ? hashtable_init_arena(&ht, ks, sizeof(uint64_t), capacity)
+                         : hashtable_init(&ht, ks, sizeof(uint64_t), capacity);
+    if (!ok) {
+        return;
+    }
+    hashtable_set_hash(&ht, w->hash, NULL);
+    hashtable_set_probe(&ht, w->probe);
+    uint64_t value = 0;
+    uint64_t ns = BENCH_PHASE(w, w->n, (value = i, hashtable_put(&ht, w->keys + i * ks, &value)));
+    report(cfg, w, "put", w->n, ns);
+
+    uint64_t found = 0;
+    ns = BENCH_PHASE(w, w->ops, found += hashtable_find(&ht, w->keys + w->access[i] * ks) != NULL);
+    report(cfg, w, "find_hit", w->ops, ns);
+    ns = BENCH_PHASE(w, w->ops, found += hashtable_find(&ht, w->miss_keys + w->access[i] * ks) != NULL);
+    report(cfg, w, "find_miss", w->ops, ns);
+    bench_sink += found;
+
+    HTIterator itr;
+    perf_start(w->perf);
+    uint64_t start = bench_now_ns();
+    size_t visited = 0;
+    for (const Hashentry *entry = HTIterator_start(&itr, &ht); entry; entry = HTIterator_next(&itr)) {
+        visited += *(const uint64_t *)entry->value & 1;
+    }
+    ns = bench_now_ns() - start;
+    perf_stop(w->perf);
+    bench_sink += visited;
+    report(cfg, w, "iterate", ht.count, ns);
+
+    perf_start(w->perf);
+    start = bench_now_ns();
+    hashtable_resize(&ht, 2 * ht.capacity);
+    ns = bench_now_ns() - start;
+    perf_stop(w->perf);
+    w->samples[w->sample_count++] = ns; // a single operation, its latency is the phase time
+    report(cfg, w, "resize", 1, ns);
+
+    ns = BENCH_PHASE(w, w->n, hashtable_remove(&ht, w->keys + i * ks));
+    report(cfg, w, "remove", w->n, ns);
+    hashtable_deinit(&ht);
+}
+
+// approximate bytes per element: the entry array at the load factor plus the two malloc'd key/value chunks
+static size_t bytes_per_element(size_t key_size, double load_factor) {
+    size_t chunk = (key_size + 8 + 15) / 16 * 16 + 32;
+    return (size_t)(sizeof(Hashentry) / load_factor) + chunk;
+}
+
+static long cache_size(int name, long fallback) {
+    long size = sysconf(name);
+    return size > 0 ? size : fallback;
+}
+
+// sizes spanning L1, L2, LLC and 10x LLC for the smallest configured key size
+static void default_sizes(BenchConfig *cfg) {
+    long llc = cache_size(_SC_LEVEL3_CACHE_SIZE, 8l << 20);
+    long footprints[] = {cache_size(_SC_LEVEL1_DCACHE_SIZE, 32l << 10), cache_size(_SC_LEVEL2_CACHE_SIZE, 1l << 20), llc, 10 * llc};
+    size_t per_element = bytes_per_element(cfg->key_sizes[0], cfg->load_factors[0]);
+    cfg->size_count = cfg->quick ? 2 : 4;
+    for (unsigned int i = 0; i < cfg->size_count; i++) {
+        cfg->sizes[i] = (size_t)footprints[i] / per_element;
+    }
+}
+
+static unsigned int parse_sizes(const char *arg, size_t *out) {
+    unsigned int count = 0;
+    for (char *end; *arg && count < MAX_LIST; arg = *end ? end + 1 : end) {
+        out[count++] = strtoull(arg, &end, 10);
+    }
+    return count;
+}
+
+static unsigned int parse_doubles(const char *arg, double *out) {
+    unsigned int count = 0;
+    for (char *end; *arg && count < MAX_LIST; arg = *end ? end + 1 : end) {
+        out[count++] = strtod(arg, &end);
+    }
+    return count;
+}
+
+// index of the name arg[0, len) in names, -1 when it isn't one of them
+static int name_index(const char *arg, size_t len, const char **names, unsigned int name_count) {
+    for (unsigned int i = 0; i < name_count; i++) {
+        if (strlen(names[i]) == len && strncmp(arg, names[i], len) == 0) {
+            return (int)i;
+        }
+    }
+    return -1;
+}
+
+static unsigned int parse_dists(const char *arg, BenchDist *out) {
+    unsigned int count = 0;
+    while (*arg && count < MAX_LIST) {
+        size_t len = strcspn(arg, ",");
+        int d = name_index(arg, len, dist_names, sizeof(dist_names) / sizeof(dist_names[0]));
+        if (d >= 0) {
+            out[count++] = (BenchDist)d;
+        }
+        arg += len + (arg[len] == ',');
+    }
+    return count;
+}
+
+static unsigned int parse_hashes(const char *arg, HTHashKind *out) {
+    unsigned int count = 0;
+    while (*arg && count < MAX_LIST) {
+        size_t len = strcspn(arg, ",");
+        int h = name_index(arg, len, hash_names, sizeof(hash_names) / sizeof(hash_names[0]));
+        if (h >= 0) {
+            out[count++] = (HTHashKind)h;
+        }
+        arg += len + (arg[len] == ',');
+    }
+    return count;
+}
+
+static unsigned int parse_probes(const char *arg, HTProbeStrategy *out) {
+    unsigned int count = 0;
+    while (*arg && count < MAX_LIST) {
+        size_t len = strcspn(arg, ",");
+        int p = name_index(arg, len, probe_names, sizeof(probe_names) / sizeof(probe_names[0]));
+        if (p >= 0) {
+            out[count++] = (HTProbeStrategy)p;
+        }
+        arg += len + (arg[len] == ',');
+    }
+    return count;
+}
+
+// reads a whole key file, *n is set to the number of complete key_size keys in it
+static unsigned char *read_keys(const char *path, size_t key_size, size_t *n) {
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        fprintf(stderr, "unable to open key file %s\n", path);
+        return NULL;
+    }
+    fseek(f, 0, SEEK_END);
+    long bytes = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    *n = bytes > 0 ? (size_t)bytes / key_size : 0;
+    unsigned char *keys = (unsigned char *)malloc(*n * key_size + 1);
+    if (!keys || fread(keys, key_size, *n, f) != *n) {
+        fprintf(stderr, "failed to read %zu keys from %s\n", *n, path);
+        free(keys);
+        keys = NULL;
+    }
+    fclose(f);
+    return keys;
+}
+
+/**
+ * --hash-bench: hash throughput over the key set (through the public hash functions, so every hash pays
+ * the same indirect call), then the probe length of every key after inserting them all with that hash.
+ * Probe lengths count slots examined by a successful find, 1 means the key sits in its home slot.
+ */
+static int run_hash_bench(const BenchConfig *cfg) {
+    const size_t ks = cfg->key_sizes[0];
+    size_t n;
+    unsigned char *keys = read_keys(cfg->hash_bench_path, ks, &n);
+    uint64_t *lengths = keys ? (uint64_t *)malloc((n + 1) * sizeof(uint64_t)) : NULL;
+    if (!lengths || n == 0) {
+        fprintf(stderr, "--hash-bench needs a non empty key file of %zu byte keys\n", ks);
+        free(keys);
+        free(lengths);
+        return 1;
+    }
+    // repeat small key sets so each measurement covers at least ~16M hashes
+    size_t passes = n < (16u << 20) ? (16u << 20) / n : 1;
+    fprintf(cfg->csv, "probing,hash,key_size,keys,load_factor,hash_ns_per_key,hash_gb_per_s,probe_mean,probe_p50,probe_p99,probe_max,home_slot_pct\n");
+    for (unsigned int c = 0; c < cfg->hash_count * cfg->probe_count; c++) {
+        HTHashKind kind = cfg->hashes[c / cfg->probe_count];
+        HTProbeStrategy probe = cfg->probes[c % cfg->probe_count];
+        HTHashFunc func = hash_funcs[kind];
+        uint64_t acc = 0;
+        uint64_t start = bench_now_ns();
+        for (size_t p = 0; p < passes; p++) {
+            for (size_t i = 0; i < n; i++) {
+                acc += func(keys + i * ks, ks);
+            }
+        }
+        uint64_t ns = bench_now_ns() - start;
+        bench_sink += acc;
+        double ns_per_key = (double)ns / ((double)passes * n);
+
+        Hashtable ht;
+        if (!hashtable_init(&ht, ks, 0, (ht_index_t)(n / cfg->load_factors[0]) + 1)) {
+            break;
+        }
+        hashtable_set_hash(&ht, kind, NULL);
+        hashtable_set_probe(&ht, probe);
+        for (size_t i = 0; i < n; i++) {
+            hashtable_put(&ht, keys + i * ks, NULL);
+        }
+        double sum = 0;
+        size_t home = 0;
+        for (size_t i = 0; i < n; i++) {
+            lengths[i] = hashtable_probe_length(&ht, keys + i * ks);
+            sum += (double)lengths[i];
+            home += lengths[i] == 1;
+        }
+        qsort(lengths, n, sizeof(uint64_t), compare_u64);
+        fprintf(cfg->csv, "%s,%s,%zu,%zu,%.2f,%.3f,%.3f,%.3f,%llu,%llu,%llu,%.2f\n",
+                probe_names[probe], hash_names[kind], ks, n, (double)ht.count / ht.capacity, ns_per_key,
+                ns_per_key > 0 ? ks / ns_per_key : 0, sum / n,
+                (unsigned long long)percentile(lengths, n, 0.50),
+                (unsigned long long)percentile(lengths, n, 0.99),
+                (unsigned long long)lengths[n - 1], 100.0 * home / n);
+        fflush(cfg->csv);
+        hashtable_deinit(&ht);
+    }
+    free(keys);
+    free(lengths);
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    BenchConfig cfg = {
+        .key_sizes = {4, 8, 16, 32}, .key_size_count = 4,
+        .load_factors = {0.5}, .load_factor_count = 1,
+        .dists = {DIST_UNIFORM, DIST_ZIPF, DIST_SEQUENTIAL}, .dist_count = 3,
+        .hashes = {HT_HASH_XXH64}, .hash_count = 1,
+        .probes = {HT_PROBE_DEFAULT}, .probe_count = 1,
+        .seed = 42,
+        .csv = stdout,
+    };
+    BenchPerf perf;
+    for (int i = 1; i < argc; i++) {
+        const char *next = i + 1 < argc ? argv[i + 1] : "";
+        if (strcmp(argv[i], "--quick") == 0) {
+            cfg.quick = true;
+        } else if (strcmp(argv[i], "--sizes") == 0) {
+            cfg.size_count = parse_sizes(next, cfg.sizes), i++;
+        } else if (strcmp(argv[i], "--key-sizes") == 0) {
+            cfg.key_size_count = parse_sizes(next, cfg.key_sizes), i++;
+        } else if (strcmp(argv[i], "--load-factors") == 0) {
+            cfg.load_factor_count = parse_doubles(next, cfg.load_factors), i++;
+        } else if (strcmp(argv[i], "--dists") == 0) {
+            cfg.dist_count = parse_dists(next, cfg.dists), i++;
+        } else if (strcmp(argv[i], "--perf") == 0) {
+            cfg.perf = &perf;
+        } else if (strcmp(argv[i], "--arena") == 0) {
+            cfg.arena = true;
+        } else if (strcmp(argv[i], "--hashes") == 0) {
+            cfg.hash_count = parse_hashes(next, cfg.hashes), i++;
+        } else if (strcmp(argv[i], "--probes") == 0) {
+            cfg.probe_count = parse_probes(next, cfg.probes), i++;
+        } else if (strcmp(argv[i], "--hash-bench") == 0) {
+            cfg.hash_bench_path = next, i++;
+        } else if (strcmp(argv[i], "--ops") == 0) {
+            cfg.ops = strtoull(next, NULL, 10), i++;
+        } else if (strcmp(argv[i], "--seed") == 0) {
+            cfg.seed = strtoull(next, NULL, 10), i++;
+        } else if (strcmp(argv[i], "--csv") == 0) {
+            cfg.csv = fopen(next, "w"), i++;
+            if (!cfg.csv) {
+                fprintf(stderr, "unable to open %s for writing\n", next);
+                return 1;
+            }
+        } else {
+            fprintf(stderr, "unknown option %s, see the usage comment in hashtable_bench.c\n", argv[i]);
+            return 1;
+        }
+    }
+    for (unsigned int i = 0; i < cfg.load_factor_count; i++) {
+        // the table grows at TARGET_LOAD_FACTOR, higher requested load factors can't be held
+        if (cfg.load_factors[i] <= 0 || cfg.load_factors[i] >= TARGET_LOAD_FACTOR) {
+            cfg.load_factors[i] = TARGET_LOAD_FACTOR - 0.01;
+        }
+    }
+    if (cfg.hash_bench_path) {
+        int ret = cfg.key_size_count > 0 && cfg.load_factor_count > 0 ? run_hash_bench(&cfg) : 1;
+        if (cfg.csv != stdout) {
+            fclose(cfg.csv);
+        }
+        return ret;
+    }
+    if (cfg.size_count == 0) {
+        default_sizes(&cfg);
+    }
+    if (cfg.perf && !perf_open(cfg.perf)) {
+        fprintf(stderr, "--perf: no hardware counters available (perf_event_open failed, see perf_event_paranoid)\n");
+        return 1;
+    }
+
+    fprintf(cfg.csv, "probing,hash,size,key_size,load_factor,dist,op,ops,total_ns,mops_per_s,ns_per_op,p50_ns,p90_ns,p99_ns,p999_ns,max_ns");
+    for (int i = 0; cfg.perf && i < PERF_EVENTS; i++) {
+        fprintf(cfg.csv, ",%s_per_op", perf_names[i]);
+    }
+    fprintf(cfg.csv, "\n");
+    for (unsigned int s = 0; s < cfg.size_count; s++) {
+        for (unsigned int k = 0; k < cfg.key_size_count; k++) {
+            for (unsigned int l = 0; l < cfg.load_factor_count; l++) {
+                for (unsigned int d = 0; d < cfg.dist_count; d++) {
+                    for (unsigned int h = 0; h < cfg.hash_count; h++) {
+                        BenchWorkload w = {0};
+                        if (cfg.sizes[s] > 0 && cfg.key_sizes[k] > 0 &&
+                            workload_init(&w, &cfg, cfg.sizes[s], cfg.key_sizes[k], cfg.load_factors[l], cfg.dists[d], cfg.hashes[h])) {
+                            for (unsigned int p = 0; p < cfg.probe_count; p++) {
+                                w.probe = cfg.probes[p];
+                                run_workload(&cfg, &w);
+                            }
+                        }
+                        workload_deinit(&w);
+                    }
+                }
+            }
+        }
+    }
+    if (cfg.perf) {
+        perf_close(cfg.perf);
+    }
+    if (cfg.csv != stdout) {
+        fclose(cfg.csv);
+    }
+    return 0;
+}
@@ -0,0 +1,281 @@
+#pragma once
+
+#include "hashtable.h"
+
+/**
+ * Compile time type specialized hashtables, in the spirit of khash.
+ *
+ * HASHTABLE_DEFINE(name, KeyT, ValT, hash_fn, eq_fn) generates a struct `name` plus a family of
+ * static inline functions prefixed with `name_` that follow the same semantics as the generic
+ * Hashtable: open addressing, tombstones on remove, put overwrites an existing key and the table
+ * grows once TARGET_LOAD_FACTOR is reached.
+ *
+ * Unlike the generic table keys and values are stored by value inside the entries (no per entry
+ * malloc) and the key comparison/hash are plain expressions, so small keys end up as register
+ * compares and integer finalizers once inlined.
+ *
+ * hash_fn must be callable as hash_fn(KeyT) and return a uint64_t, eq_fn as eq_fn(KeyT, KeyT)
+ * returning true for equal keys, both may be functions or function like macros.
+ * e.g. HASHTABLE_DEFINE(inttable, int, int, HASHTABLE_HASH_INT, HASHTABLE_EQ_SCALAR)
+ *
+ * Capacities are powers of two so the start index is a mask instead of a modulo, with QUAD_PROBING
+ * the probe sequence uses triangular numbers which visits every slot of a power of two table.
+ */
+
+// convenience hash/eq for integer and pointer keys, usable as the hash_fn/eq_fn arguments
+#define HASHTABLE_HASH_INT(key) hashtable_mix64((uint64_t)(key))
+#define HASHTABLE_EQ_SCALAR(a, b) ((a) == (b))
+// memcmp based equality for plain structs without padding
+#define HASHTABLE_EQ_MEMCMP(a, b) (memcmp(&(a), &(b), sizeof(a)) == 0)
+
+// rounds x up to the next power of two, 0 and 1 become 1
+static inline size_t hashtable_define_pow2(size_t x) {
+    size_t cap = 1;
+    while (cap < x) {
+        cap <<= 1;
+    }
+    return cap;
+}
+
+// entry array allocation, zeroed so every entry starts ENTRY_UNUSED. With HASHTABLE_HUGEPAGES large arrays are
+// mapped on huge pages which needs hashtable.c linked in.
+static inline void *hashtable_define_alloc(size_t count, size_t size) {
+    if (size != 0 && count > SIZE_MAX / size) { // 64 bit capacities can overflow the byte count
+        return NULL;
+    }
+#ifdef HASHTABLE_HUGEPAGES
+    if (count * size >= HT_HUGEPAGE_MIN_BYTES) {
+        return hashtable_huge_alloc(count * size);
+    }
+#endif
+    return calloc(count, size);
+}
+
+static inline void hashtable_define_free(void *ptr, size_t count, size_t size) {
+#ifdef HASHTABLE_HUGEPAGES
+    if (count * size >= HT_HUGEPAGE_MIN_BYTES) {
+        hashtable_huge_free(ptr, count * size);
+        return;
+    }
+#else
+    (void)count;
+    (void)size;
+#endif
+    free(ptr);
+}
+
+// step to the next probe index, x is the probe number starting at 1
+#ifdef QUAD_PROBING
+#define HASHTABLE_DEFINE_NEXT_IDX(idx, x, mask) (((idx) + (x)) & (mask))
+#else
+#define HASHTABLE_DEFINE_NEXT_IDX(idx, x, mask) (((idx) + 1) & (mask))
+#endif
+
+#define HASHTABLE_DEFINE(name, KeyT, ValT, hash_fn, eq_fn) \
+    HASHTABLE_DECLARE_TYPES(name, KeyT, ValT) \
+    HASHTABLE_DEFINE_FUNCS(name, KeyT, ValT, hash_fn, eq_fn)
+
+#define HASHTABLE_DECLARE_TYPES(name, KeyT, ValT) \
+    typedef struct name##_entry { \
+        KeyT key; \
+        ValT value; \
+        unsigned char state; /* EntryState */ \
+    } name##_entry; \
+    \
+    typedef struct name { \
+        size_t capacity; /* always a power of two */ \
+        size_t count; \
+        size_t used; /* count + tombstones, drives resizing */ \
+        name##_entry *arr; \
+    } name; \
+    \
+    typedef struct name##_iterator { \
+        size_t curr_idx; \
+        const name *ht; \
+    } name##_iterator;
+
+#define HASHTABLE_DEFINE_FUNCS(name, KeyT, ValT, hash_fn, eq_fn) \
+    static inline bool name##_init(name *ht, size_t base_capacity) { \
+        if (!ht || base_capacity < 1) { \
+            fprintf(stderr, #name "_init requires a valid table pointer and a positive capacity\n"); \
+            return false; \
+        } \
+        ht->capacity = hashtable_define_pow2(base_capacity < 2 ? 2 : base_capacity); \
+        ht->count = 0; \
+        ht->used = 0; \
+        /* ENTRY_UNUSED is 0 so zeroed memory leaves every entry unused */ \
+        ht->arr = (name##_entry *)hashtable_define_alloc(ht->capacity, sizeof(name##_entry)); \
+        if (!ht->arr) { \
+            fprintf(stderr, "Unable to allocate memory for " #name " entries\n"); \
+            return false; \
+        } \
+        return true; \
+    } \
+    \
+    static inline void name##_deinit(name *ht) { \
+        if (!ht) { \
+            return; \
+        } \
+        hashtable_define_free(ht->arr, ht->capacity, sizeof(name##_entry)); \
+        ht->arr = NULL; \
+        ht->capacity = ht->count = ht->used = 0; \
+    } \
+    \
+    /* returns the index of key or SIZE_MAX when it is not present */ \
+    static inline size_t name##_probe_used_idx(const name *ht, KeyT key) { \
+        const size_t mask = ht->capacity - 1; \
+        size_t idx = (size_t)(hash_fn(key)) & mask; \
+        for (size_t x = 1; x <= ht->capacity; x++) { \
+            const name##_entry *entry = &ht->arr[idx]; \
+            if (entry->state == ENTRY_UNUSED) { \
+                return SIZE_MAX; \
+            } \
+            if (entry->state == ENTRY_USED && eq_fn(entry->key, key)) { \
+                return idx; \
+            } \
+            idx = HASHTABLE_DEFINE_NEXT_IDX(idx, x, mask); \
+        } \
+        return SIZE_MAX; \
+    } \
+    \
+    /* like probe_free_idx, sets *found when key is already present at the returned index */ \
+    static inline size_t name##_probe_free_idx(const name *ht, KeyT key, bool *found) { \
+        const size_t mask = ht->capacity - 1; \
+        size_t idx = (size_t)(hash_fn(key)) & mask; \
+        size_t first_deleted_idx = SIZE_MAX; \
+        *found = false; \
+        for (size_t x = 1; x <= ht->capacity; x++) { \
+            const name##_entry *entry = &ht->arr[idx]; \
+            if (entry->state == ENTRY_UNUSED) { \
+                return first_deleted_idx != SIZE_MAX ? first_deleted_idx : idx; \
+            } \
+            if (entry->state == ENTRY_DELETED) { \
+                if (first_deleted_idx == SIZE_MAX) { \
+                    first_deleted_idx = idx; \
+                } \
+            } else if (eq_fn(entry->key, key)) { \
+                *found = true; \
+                return idx; \
+            } \
+            idx = HASHTABLE_DEFINE_NEXT_IDX(idx, x, mask); \
+        } \
+        return first_deleted_idx; \
+    } \
+    \
+    /* rebuilds the table with a power of two capacity >= desired_capacity, dropping tombstones */ \
+    static inline bool name##_resize(name *ht, size_t desired_capacity) { \
+        size_t new_cap = hashtable_define_pow2(desired_capacity < 2 ? 2 : desired_capacity); \
+        if ((float)ht->count / new_cap >= TARGET_LOAD_FACTOR) { \
+            fprintf(stderr, "The desired capacity passed to " #name "_resize is too low to contain all current elements\n"); \
+            return false; \
+        } \
+        name##_entry *new_arr = (name##_entry *)hashtable_define_alloc(new_cap, sizeof(name##_entry)); \
+        if (!new_arr) { \
+            fprintf(stderr, "failed to allocate new internal array for " #name " during resize\n"); \
+            return false; \
+        } \
+        const size_t mask = new_cap - 1; \
+        for (size_t i = 0; i < ht->capacity; i++) { \
+            const name##_entry *old_entry = &ht->arr[i]; \
+            if (old_entry->state != ENTRY_USED) { \
+                continue; \
+            } \
+            /* no tombstones or duplicates in the new array, the first unused slot is the spot */ \
+            size_t idx = (size_t)(hash_fn(old_entry->key)) & mask; \
+            for (size_t x = 1; new_arr[idx].state != ENTRY_UNUSED; x++) { \
+                idx = HASHTABLE_DEFINE_NEXT_IDX(idx, x, mask); \
+            } \
+            new_arr[idx] = *old_entry; \
+        } \
+        hashtable_define_free(ht->arr, ht->capacity, sizeof(name##_entry)); \
+        ht->arr = new_arr; \
+        ht->capacity = new_cap; \
+        ht->used = ht->count; \
+        return true; \
+    } \
+    \
+    static inline bool name##_put(name *ht, KeyT key, ValT value) { \
+        if ((float)(ht->used + 1) / ht->capacity >= TARGET_LOAD_FACTOR) { \
+            /* mostly tombstones means a same size rebuild is enough */ \
+            size_t desired = ht->count + 1 >= ht->capacity / 2 ? 2 * ht->capacity : ht->capacity; \
+            if (!name##_resize(ht, desired)) { \
+                fprintf(stderr, #name "_put failed due to failed resize\n"); \
+                return false; \
+            } \
+        } \
+        bool found; \
+        size_t idx = name##_probe_free_idx(ht, key, &found); \
+        name##_entry *entry = &ht->arr[idx]; \
+        if (!found) { \
+            if (entry->state == ENTRY_UNUSED) { \
+                ht->used++; \
+            } \
+            entry->key = key; \
+            entry->state = ENTRY_USED; \
+            ht->count++; \
+        } \
+        entry->value = value; \
+        return true; \
+    } \
+    \
+    static inline ValT *name##_find(const name *ht, KeyT key) { \
+        size_t idx = name##_probe_used_idx(ht, key); \
+        return idx == SIZE_MAX ? NULL : &ht->arr[idx].value; \
+    } \
+    \
+    static inline bool name##_get(const name *ht, KeyT key, ValT *out_value) { \
+        size_t idx = name##_probe_used_idx(ht, key); \
+        if (idx == SIZE_MAX) { \
+            return false; \
+        } \
+        *out_value = ht->arr[idx].value; \
+        return true; \
+    } \
+    \
+    static inline bool name##_contains(const name *ht, KeyT key) { \
+        return name##_probe_used_idx(ht, key) != SIZE_MAX; \
+    } \
+    \
+    static inline bool name##_remove(name *ht, KeyT key) { \
+        size_t idx = name##_probe_used_idx(ht, key); \
+        if (idx == SIZE_MAX) { \
+            return false; \
+        } \
+        ht->arr[idx].state = ENTRY_DELETED; \
+        ht->count--; \
+        return true; \
+    } \
+    \
+    static inline void name##_clear(name *ht) { \
+        memset(ht->arr, 0, ht->capacity * sizeof(name##_entry)); \
+        ht->count = 0; \
+        ht->used = 0; \
+    } \
+    \
+    static inline size_t name##_count(const name *ht) { \
+        return ht->count; \
+    } \
+    \
+    static inline bool name##_empty(const name *ht) { \
+        return ht->count == 0; \
+    } \
+    \
+    static inline float name##_load_factor(const name *ht) { \
+        return (float)ht->count / ht->capacity; \
+    } \
+    \
+    static inline const name##_entry *name##_iterator_next(name##_iterator *iterator) { \
+        while (iterator->curr_idx < iterator->ht->capacity) { \
+            const name##_entry *entry = &iterator->ht->arr[iterator->curr_idx++]; \
+            if (entry->state == ENTRY_USED) { \
+                return entry; \
+            } \
+        } \
+        return NULL; \
+    } \
+    \
+    static inline const name##_entry *name##_iterator_start(name##_iterator *iterator, const name *ht) { \
+        iterator->ht = ht; \
+        iterator->curr_idx = 0; \
+        return name##_iterator_next(iterator); \
+    }
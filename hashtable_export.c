@@ -0,0 +1,350 @@
+#include <stdarg.h>
+#include <pthread.h>
+
+#include "hashtable_export.h"
+
+// bounded output buffer with snprintf semantics, pos keeps counting past len so the full length is known
+typedef struct ExportWriter {
+    char *buf;
+    size_t len;
+    size_t pos;
+} ExportWriter;
+
+static void export_writer_init(ExportWriter *w, char *buf, size_t len) {
+    w->buf = buf;
+    w->len = buf ? len : 0;
+    w->pos = 0;
+    if (w->len > 0) {
+        w->buf[0] = '\0';
+    }
+}
+
+static void export_printf(ExportWriter *w, const char *fmt, ...) {
+    size_t room = w->pos < w->len ? w->len - w->pos : 0;
+    va_list args;
+    va_start(args, fmt);
+    int n = vsnprintf(room ? w->buf + w->pos : NULL, room, fmt, args);
+    va_end(args);
+    if (n > 0) {
+        w->pos += (size_t)n;
+    }
+}
+
+// escapes a string for a JSON string or a Prometheus label value. The exposition format only knows \\, \" and
+// \n, other control bytes are dropped from labels.
+static void export_escaped(ExportWriter *w, const char *str, bool json) {
+    for (const unsigned char *c = (const unsigned char *)str; *c; c++) {
+        if (*c == '"' || *c == '\\') {
+            export_printf(w, "\\%c", *c);
+        } else if (*c == '\n') {
+            export_printf(w, "\\n");
+        } else if (*c < 0x20) {
+            if (json) {
+                export_printf(w, "\\u%04x", *c);
+            }
+        } else {
+            export_printf(w, "%c", *c);
+        }
+    }
+}
+
+// everything reported for one table, copied once so every metric sees the same numbers and formatting
+// never touches the table
+typedef struct ExportSnapshot {
+    const char *name;
+    ht_index_t count;
+    ht_index_t capacity;
+    HTMemoryUsage usage;
+#ifdef HASHTABLE_STATS
+    HTStats stats;
+#endif
+} ExportSnapshot;
+
+// measure walks the table for the malloc overhead, otherwise only its counters are read
+static void export_snapshot(ExportSnapshot *snap, const char *name, const Hashtable *ht, bool measure) {
+    snap->name = name;
+    snap->count = ht->count;
+    snap->capacity = ht->capacity;
+    snap->usage = measure ? hashtable_memory_usage(ht) : hashtable_memory_estimate(ht);
+#ifdef HASHTABLE_STATS
+    hashtable_get_stats(ht, &snap->stats);
+#endif
+}
+
+static double export_load_factor(const ExportSnapshot *snap) {
+    return snap->capacity ? (double)snap->count / snap->capacity : 0.0;
+}
+
+static void export_json_table(ExportWriter *w, const ExportSnapshot *snap) {
+    const HTMemoryUsage *usage = &snap->usage;
+    export_printf(w, "{");
+    if (snap->name) {
+        export_printf(w, "\"name\":\"");
+        export_escaped(w, snap->name, true);
+        export_printf(w, "\",");
+    }
+    export_printf(w, "\"count\":%llu,\"capacity\":%llu,\"load_factor\":%.6f,\"tombstones\":%llu,",
+                  (unsigned long long)snap->count, (unsigned long long)snap->capacity, export_load_factor(snap),
+                  (unsigned long long)usage->tombstones);
+    export_printf(w, "\"memory\":{\"total_bytes\":%zu,\"entry_array_bytes\":%zu,\"metadata_bytes\":%zu,"
+                  "\"key_bytes\":%zu,\"value_bytes\":%zu,\"malloc_overhead_bytes\":%zu,\"empty_slot_bytes\":%zu,"
+                  "\"tombstone_slot_bytes\":%zu,\"bytes_per_element\":%.2f}",
+                  usage->total_bytes, usage->entry_array_bytes, usage->metadata_bytes, usage->key_bytes,
+                  usage->value_bytes, usage->malloc_overhead_bytes, usage->empty_slot_bytes,
+                  usage->tombstone_slot_bytes, usage->bytes_per_element);
+#ifdef HASHTABLE_STATS
+    const HTStats *stats = &snap->stats;
+    export_printf(w, ",\"stats\":{\"puts\":%llu,\"finds\":%llu,\"hits\":%llu,\"misses\":%llu,\"removes\":%llu,"
+                  "\"probe_total\":%llu,\"probe_max\":%llu,\"tombstones_seen\":%llu,\"resizes\":%llu,"
+                  "\"resize_ns\":%llu,\"probe_histogram\":[",
+                  (unsigned long long)stats->puts, (unsigned long long)stats->finds,
+                  (unsigned long long)stats->hits, (unsigned long long)stats->misses,
+                  (unsigned long long)stats->removes, (unsigned long long)stats->probe_total,
+                  (unsigned long long)stats->probe_max, (unsigned long long)stats->tombstones_seen,
+                  (unsigned long long)stats->resizes, (unsigned long long)stats->resize_ns);
+    for (unsigned int i = 0; i < HT_STATS_PROBE_BUCKETS; i++) {
+        export_printf(w, "%s%llu", i ? "," : "", (unsigned long long)stats->probe_hist[i]);
+    }
+    export_printf(w, "]}");
+#endif
+    export_printf(w, "}");
+}
+
+typedef enum ExportMetricId {
+    METRIC_ENTRIES,
+    METRIC_CAPACITY,
+    METRIC_LOAD_FACTOR,
+    METRIC_TOMBSTONES,
+    METRIC_MEMORY_BYTES,
+    METRIC_BYTES_PER_ELEMENT,
+#ifdef HASHTABLE_STATS
+    METRIC_PUTS,
+    METRIC_FINDS,
+    METRIC_HITS,
+    METRIC_MISSES,
+    METRIC_REMOVES,
+    METRIC_TOMBSTONES_SEEN,
+    METRIC_RESIZES,
+    METRIC_RESIZE_SECONDS,
+#endif
+    METRIC_LAST
+} ExportMetricId;
+
+typedef struct ExportMetric {
+    const char *name;
+    const char *type;
+    const char *help;
+} ExportMetric;
+
+// indexed by ExportMetricId
+static const ExportMetric export_metrics[] = {
+    {"hashtable_entries", "gauge", "Live entries in the table."},
+    {"hashtable_capacity", "gauge", "Slots in the entry array."},
+    {"hashtable_load_factor", "gauge", "Live entries divided by capacity."},
+    {"hashtable_tombstones", "gauge", "Slots holding a tombstone."},
+    {"hashtable_memory_bytes", "gauge", "Bytes held by the table, see hashtable_memory_usage."},
+    {"hashtable_bytes_per_element", "gauge", "Memory bytes divided by live entries."},
+#ifdef HASHTABLE_STATS
+    {"hashtable_puts_total", "counter", "hashtable_put calls."},
+    {"hashtable_finds_total", "counter", "Key lookups."},
+    {"hashtable_hits_total", "counter", "Key lookups that found the key."},
+    {"hashtable_misses_total", "counter", "Key lookups that did not find the key."},
+    {"hashtable_removes_total", "counter", "Entries removed."},
+    {"hashtable_tombstones_seen_total", "counter", "Tombstones stepped over while probing."},
+    {"hashtable_resizes_total", "counter", "Rebuilds of the entry array."},
+    {"hashtable_resize_seconds_total", "counter", "Time spent rebuilding the entry array."},
+#endif
+};
+
+static void export_metric_value(ExportWriter *w, const ExportSnapshot *snap, ExportMetricId metric) {
+    switch (metric) {
+    case METRIC_ENTRIES: export_printf(w, "%llu", (unsigned long long)snap->count); break;
+    case METRIC_CAPACITY: export_printf(w, "%llu", (unsigned long long)snap->capacity); break;
+    case METRIC_LOAD_FACTOR: export_printf(w, "%.6f", export_load_factor(snap)); break;
+    case METRIC_TOMBSTONES: export_printf(w, "%llu", (unsigned long long)snap->usage.tombstones); break;
+    case METRIC_MEMORY_BYTES: export_printf(w, "%zu", snap->usage.total_bytes); break;
+    case METRIC_BYTES_PER_ELEMENT: export_printf(w, "%.2f", snap->usage.bytes_per_element); break;
+#ifdef HASHTABLE_STATS
+    case METRIC_PUTS: export_printf(w, "%llu", (unsigned long long)snap->stats.puts); break;
+    case METRIC_FINDS: export_printf(w, "%llu", (unsigned long long)snap->stats.finds); break;
+    case METRIC_HITS: export_printf(w, "%llu", (unsigned long long)snap->stats.hits); break;
+    case METRIC_MISSES: export_printf(w, "%llu", (unsigned long long)snap->stats.misses); break;
+    case METRIC_REMOVES: export_printf(w, "%llu", (unsigned long long)snap->stats.removes); break;
+    case METRIC_TOMBSTONES_SEEN: export_printf(w, "%llu", (unsigned long long)snap->stats.tombstones_seen); break;
+    case METRIC_RESIZES: export_printf(w, "%llu", (unsigned long long)snap->stats.resizes); break;
+    case METRIC_RESIZE_SECONDS: export_printf(w, "%.9f", snap->stats.resize_ns / 1e9); break;
+#endif
+    default: break;
+    }
+}
+
+static void export_label(ExportWriter *w, const ExportSnapshot *snap) {
+    export_printf(w, "{table=\"");
+    export_escaped(w, snap->name ? snap->name : "", false);
+    export_printf(w, "\"");
+}
+
+static void export_prometheus(ExportWriter *w, const ExportSnapshot *snaps, unsigned int snap_count) {
+    for (unsigned int m = 0; m < METRIC_LAST; m++) {
+        const ExportMetric *metric = &export_metrics[m];
+        export_printf(w, "# HELP %s %s\n# TYPE %s %s\n", metric->name, metric->help, metric->name, metric->type);
+        for (unsigned int t = 0; t < snap_count; t++) {
+            export_printf(w, "%s", metric->name);
+            export_label(w, &snaps[t]);
+            export_printf(w, "} ");
+            export_metric_value(w, &snaps[t], (ExportMetricId)m);
+            export_printf(w, "\n");
+        }
+    }
+#ifdef HASHTABLE_STATS
+    export_printf(w, "# HELP hashtable_probe_length Slots examined per probe.\n# TYPE hashtable_probe_length histogram\n");
+    for (unsigned int t = 0; t < snap_count; t++) {
+        const HTStats *stats = &snaps[t].stats;
+        uint64_t cumulative = 0;
+        for (unsigned int i = 0; i < HT_STATS_PROBE_BUCKETS; i++) {
+            cumulative += stats->probe_hist[i];
+            export_printf(w, "hashtable_probe_length_bucket");
+            export_label(w, &snaps[t]);
+            if (i == HT_STATS_PROBE_BUCKETS - 1) {
+                export_printf(w, ",le=\"+Inf\"} %llu\n", (unsigned long long)cumulative);
+            } else {
+                export_printf(w, ",le=\"%u\"} %llu\n", i + 1, (unsigned long long)cumulative);
+            }
+        }
+        export_printf(w, "hashtable_probe_length_sum");
+        export_label(w, &snaps[t]);
+        export_printf(w, "} %llu\nhashtable_probe_length_count", (unsigned long long)stats->probe_total);
+        export_label(w, &snaps[t]);
+        export_printf(w, "} %llu\n", (unsigned long long)cumulative);
+    }
+#endif
+}
+
+size_t hashtable_stats_json(const Hashtable *ht, char *buf, size_t len) {
+    ExportWriter w;
+    export_writer_init(&w, buf, len);
+    ExportSnapshot snap;
+    export_snapshot(&snap, NULL, ht, true);
+    export_json_table(&w, &snap);
+    return w.pos;
+}
+
+size_t hashtable_stats_prometheus(const Hashtable *ht, const char *name, char *buf, size_t len) {
+    ExportWriter w;
+    export_writer_init(&w, buf, len);
+    ExportSnapshot snap;
+    export_snapshot(&snap, name, ht, true);
+    export_prometheus(&w, &snap, 1);
+    return w.pos;
+}
+
+typedef struct RegistryEntry {
+    char name[HT_REGISTRY_NAME_MAX];
+    const Hashtable *ht;
+    HTRegistryLockFunc lock; // NULL for tables registered without a lock
+    HTRegistryLockFunc unlock;
+    void *lock_ctx;
+} RegistryEntry;
+
+static RegistryEntry registry[HT_REGISTRY_MAX_TABLES];
+static unsigned int registry_count;
+static pthread_mutex_t registry_lock = PTHREAD_MUTEX_INITIALIZER;
+
+bool hashtable_registry_add(const char *name, const Hashtable *ht) {
+    return hashtable_registry_add_locked(name, ht, NULL, NULL, NULL);
+}
+
+bool hashtable_registry_add_locked(const char *name, const Hashtable *ht, HTRegistryLockFunc lock,
+                                   HTRegistryLockFunc unlock, void *lock_ctx) {
+    if (!name || !ht || !lock != !unlock) {
+        fprintf(stderr, "hashtable_registry_add needs a name, a table and both or neither lock callbacks\n");
+        return false;
+    }
+    pthread_mutex_lock(&registry_lock);
+    unsigned int idx = 0;
+    while (idx < registry_count && registry[idx].ht != ht) {
+        idx++;
+    }
+    bool added = idx < HT_REGISTRY_MAX_TABLES;
+    if (added) {
+        snprintf(registry[idx].name, sizeof(registry[idx].name), "%s", name);
+        registry[idx].ht = ht;
+        registry[idx].lock = lock;
+        registry[idx].unlock = unlock;
+        registry[idx].lock_ctx = lock_ctx;
+        if (idx == registry_count) {
+            registry_count++;
+        }
+    } else {
+        fprintf(stderr, "hashtable registry is full, %s was not added\n", name);
+    }
+    pthread_mutex_unlock(&registry_lock);
+    return added;
+}
+
+bool hashtable_registry_remove(const Hashtable *ht) {
+    bool removed = false;
+    pthread_mutex_lock(&registry_lock);
+    for (unsigned int i = 0; i < registry_count; i++) {
+        if (registry[i].ht == ht) {
+            // keep registration order for stable output
+            memmove(&registry[i], &registry[i + 1], (registry_count - i - 1) * sizeof(RegistryEntry));
+            registry_count--;
+            removed = true;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&registry_lock);
+    return removed;
+}
+
+unsigned int hashtable_registry_count(void) {
+    pthread_mutex_lock(&registry_lock);
+    unsigned int count = registry_count;
+    pthread_mutex_unlock(&registry_lock);
+    return count;
+}
+
+// copies the counters of every registered table under its lock, called with registry_lock held
+static unsigned int registry_snapshot(ExportSnapshot *snaps) {
+    for (unsigned int i = 0; i < registry_count; i++) {
+        const RegistryEntry *entry = &registry[i];
+        if (entry->lock) {
+            entry->lock(entry->lock_ctx);
+        }
+        export_snapshot(&snaps[i], entry->name, entry->ht, false);
+        if (entry->unlock) {
+            entry->unlock(entry->lock_ctx);
+        }
+    }
+    return registry_count;
+}
+
+size_t hashtable_registry_json(char *buf, size_t len) {
+    ExportWriter w;
+    export_writer_init(&w, buf, len);
+    ExportSnapshot snaps[HT_REGISTRY_MAX_TABLES];
+    pthread_mutex_lock(&registry_lock);
+    unsigned int snap_count = registry_snapshot(snaps);
+    export_printf(&w, "{\"tables\":[");
+    for (unsigned int i = 0; i < snap_count; i++) {
+        if (i > 0) {
+            export_printf(&w, ",");
+        }
+        export_json_table(&w, &snaps[i]);
+    }
+    export_printf(&w, "]}");
+    pthread_mutex_unlock(&registry_lock);
+    return w.pos;
+}
+
+size_t hashtable_registry_prometheus(char *buf, size_t len) {
+    ExportWriter w;
+    export_writer_init(&w, buf, len);
+    ExportSnapshot snaps[HT_REGISTRY_MAX_TABLES];
+    pthread_mutex_lock(&registry_lock);
+    unsigned int snap_count = registry_snapshot(snaps);
+    export_prometheus(&w, snaps, snap_count);
+    pthread_mutex_unlock(&registry_lock);
+    return w.pos;
+}
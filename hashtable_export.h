@@ -0,0 +1,51 @@
+#pragma once
+
+#include "hashtable.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Machine readable table health: JSON objects and Prometheus text exposition format.
+ *
+ * Every table reports count, capacity, load factor, tombstones and the hashtable_memory_usage breakdown.
+ * Built with HASHTABLE_STATS the HTStats counters are added: operation counts, resizes and the probe length
+ * histogram (a Prometheus histogram with cumulative le buckets).
+ *
+ * The formatters follow snprintf: at most len bytes including the terminator are written to buf and the
+ * return value is the length of the complete output, a result >= len means buf was too small.
+ * hashtable_stats_json/prometheus walk the table (hashtable_memory_usage), it must not be modified concurrently.
+ *
+ * Registry scrapes only read the table's counters (hashtable_memory_estimate), O(1) per table. Tables used from
+ * other threads are registered with the lock their owners modify them under, the scrape holds it just long
+ * enough to copy the counters. Tables registered without a lock must not be modified during a scrape.
+ */
+
+// longest registered table name, longer names are truncated
+#define HT_REGISTRY_NAME_MAX 64
+#define HT_REGISTRY_MAX_TABLES 64
+
+size_t hashtable_stats_json(const Hashtable *ht, char *buf, size_t len);
+// name becomes the table="name" label of every sample
+size_t hashtable_stats_prometheus(const Hashtable *ht, const char *name, char *buf, size_t len);
+
+// process wide registry of named tables, e.g. for a metrics endpoint. A table must be removed before it
+// is destroyed. Adding an already registered table renames it. Returns false when the registry is full.
+bool hashtable_registry_add(const char *name, const Hashtable *ht);
+// called around each scrape of a table with lock_ctx, e.g. a pthread_mutex_lock/unlock pair. Scrapes take the
+// registry lock first, don't call registry functions while holding a registered table's lock.
+typedef void (*HTRegistryLockFunc)(void *lock_ctx);
+bool hashtable_registry_add_locked(const char *name, const Hashtable *ht, HTRegistryLockFunc lock,
+                                   HTRegistryLockFunc unlock, void *lock_ctx);
+bool hashtable_registry_remove(const Hashtable *ht);
+unsigned int hashtable_registry_count(void);
+
+// {"tables":[{"name":"..", ...}, ..]} for every registered table
+size_t hashtable_registry_json(char *buf, size_t len);
+// one HELP/TYPE header per metric followed by a sample for every registered table
+size_t hashtable_registry_prometheus(char *buf, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,106 @@
+#include <cassert>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <string_view>
+
+#include "hashtable.hpp"
+
+struct StringHash {
+    using is_transparent = void;
+    size_t operator()(std::string_view s) const { return std::hash<std::string_view>{}(s); }
+};
+
+struct StringEq {
+    using is_transparent = void;
+    bool operator()(std::string_view a, std::string_view b) const { return a == b; }
+};
+
+int main() {
+    FlatHashMap<int, int> map(10);
+    for (int i = 0; i < 1000; i++) {
+        assert(map.try_emplace(i, i * 2).second);
+    }
+    assert(map.size() == 1000);
+    assert(!map.try_emplace(5, 0).second);
+    assert(map.at(5) == 10);
+    for (int i = 0; i < 1000; i++) {
+        auto it = map.find(i);
+        assert(it != map.end());
+        assert(it->second == i * 2);
+    }
+    for (int i = 0; i < 250; i++) {
+        assert(map.erase(i) == 1);
+        assert(!map.contains(i));
+    }
+    size_t itr_cnt = 0;
+    for (const auto &kv : map) {
+        assert(kv.first >= 250);
+        itr_cnt++;
+    }
+    assert(itr_cnt == map.size() && map.size() == 750);
+    printf("Passed FlatHashMap try_emplace/find/erase/range-for tests\n");
+
+    // move only values are constructed in place and moved on growth
+    FlatHashMap<int, std::unique_ptr<int>> owned(2);
+    for (int i = 0; i < 100; i++) {
+        owned.try_emplace(i, std::make_unique<int>(i));
+    }
+    for (int i = 0; i < 100; i++) {
+        assert(*owned.at(i) == i);
+    }
+    owned[7] = std::make_unique<int>(-7);
+    assert(*owned.at(7) == -7);
+    FlatHashMap<int, std::unique_ptr<int>> moved(std::move(owned));
+    assert(moved.size() == 100 && owned.size() == 0);
+    printf("Passed FlatHashMap move only value tests\n");
+
+    // a moved-from map has no slots: lookups miss, copies stay empty and inserts allocate first
+    assert(owned.capacity() == 0 && owned.begin() == owned.end());
+    assert(!owned.contains(3) && owned.find(3) == owned.end() && owned.erase(3) == 0);
+    FlatHashMap<int, std::unique_ptr<int>> reused(std::move(owned));
+    assert(reused.capacity() == 0);
+    assert(owned.try_emplace(3, std::make_unique<int>(30)).second);
+    assert(owned.size() == 1 && *owned.at(3) == 30);
+    FlatHashMap<int, int> empty_source(std::move(map));
+    FlatHashMap<int, int> empty_copy(map);
+    assert(empty_copy.capacity() == 0 && empty_copy.empty());
+    empty_copy[1] = 2;
+    assert(empty_copy.at(1) == 2);
+
+    // an existing key at the load threshold neither grows the table nor invalidates iterators
+    FlatHashMap<int, int> full(16);
+    int next = 0;
+    while (static_cast<float>(full.size() + 2) / full.capacity() < TARGET_LOAD_FACTOR) {
+        full.try_emplace(next, next);
+        next++;
+    }
+    full.try_emplace(next, next); // the next new key would grow the table
+    size_t threshold_capacity = full.capacity();
+    auto first = full.find(0);
+    auto existing = full.try_emplace(0, -1);
+    assert(!existing.second && existing.first == first && first->second == 0);
+    assert(full.capacity() == threshold_capacity);
+    full.try_emplace(next + 1, 0);
+    assert(full.capacity() > threshold_capacity);
+    printf("Passed FlatHashMap moved-from and load threshold tests\n");
+
+    // heterogeneous lookup, no std::string is built for the string_view probes
+    FlatHashMap<std::string, int, StringHash, StringEq> names;
+    names.insert_or_assign("alpha", 1);
+    names.insert_or_assign("beta", 2);
+    names.insert_or_assign("alpha", 3);
+    assert(names.size() == 2);
+    assert(names.find(std::string_view("alpha"))->second == 3);
+    assert(names.contains(std::string_view("beta")));
+    assert(names.erase(std::string_view("beta")) == 1);
+    assert(!names.contains(std::string_view("beta")));
+    names.insert_or_assign("gamma", 4);
+    auto gamma = names.find(std::string_view("gamma"));
+    names.erase(gamma); // a non const iterator must not bind to the transparent erase
+    assert(names.size() == 1 && !names.contains(std::string_view("gamma")));
+    printf("Passed FlatHashMap heterogeneous lookup tests\n");
+
+    printf("All FlatHashMap tests/asserts passed\n");
+    return 0;
+}
@@ -0,0 +1,311 @@
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE // pthread_setaffinity_np, sched_getcpu, syscall
+#endif
+
+#include "hashtable_numa.h"
+
+#ifdef __linux__
+#include <sched.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
+#endif
+
+// allocations at least this large get their own node bound mapping (entry arrays, bitmaps of big tables),
+// smaller ones are malloc'ed and placed by first touch
+#define NUMA_MMAP_MIN (64 * 1024)
+
+static _Thread_local int thread_node = -1;
+// node of the CPU the thread last ran on, looked up again only when sched_getcpu reports another CPU
+static _Thread_local int last_cpu = -1;
+static _Thread_local unsigned int last_cpu_node;
+
+static unsigned int physical_node(unsigned int node) {
+    return node % hashtable_numa_node_count();
+}
+
+#ifdef __linux__
+static size_t numa_mapping_bytes(size_t size) {
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    return (size + page - 1) / page * page;
+}
+#endif
+
+static void *numa_alloc(void *ctx, size_t size) {
+#ifdef __linux__
+    HTNumaShard *shard = (HTNumaShard *)ctx;
+    if (size >= NUMA_MMAP_MIN) {
+        void *ptr;
+#ifdef HASHTABLE_HUGEPAGES
+        if (size >= HT_HUGEPAGE_MIN_BYTES) {
+            ptr = hashtable_huge_alloc(size);
+        } else
+#endif
+        {
+            ptr = mmap(NULL, numa_mapping_bytes(size), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            ptr = ptr == MAP_FAILED ? NULL : ptr;
+        }
+        if (!ptr) {
+            return NULL;
+        }
+        // nothing is touched yet so every page is faulted in on the node, preferred keeps working when it is full
+        unsigned int node = physical_node(shard->node);
+        unsigned long mask = 1ul << node;
+        if (node < 8 * sizeof(mask)) {
+            shard->bound = syscall(SYS_mbind, ptr, numa_mapping_bytes(size), MPOL_PREFERRED, &mask,
+                                   (unsigned long)node + 2, 0) == 0;
+        }
+        return ptr;
+    }
+#else
+    (void)ctx;
+#endif
+    return malloc(size);
+}
+
+static void numa_free(void *ctx, void *ptr, size_t size) {
+    (void)ctx;
+    if (!ptr) {
+        return;
+    }
+#ifdef __linux__
+    if (size >= NUMA_MMAP_MIN) {
+#ifdef HASHTABLE_HUGEPAGES
+        if (size >= HT_HUGEPAGE_MIN_BYTES) {
+            hashtable_huge_free(ptr, size);
+            return;
+        }
+#endif
+        munmap(ptr, numa_mapping_bytes(size));
+        return;
+    }
+#endif
+    free(ptr);
+}
+
+static void *numa_realloc(void *ctx, void *ptr, size_t old_size, size_t new_size) {
+    void *moved = numa_alloc(ctx, new_size);
+    if (moved && ptr) {
+        memcpy(moved, ptr, old_size < new_size ? old_size : new_size);
+        numa_free(ctx, ptr, old_size);
+    }
+    return moved;
+}
+
+bool hashtable_numa_init(HTNumaTable *t, size_t key_size, size_t value_size, ht_index_t base_capacity,
+                         unsigned int node_count, unsigned int shards_per_node) {
+    if (!t || shards_per_node < 1 || key_size < 1) {
+        fprintf(stderr, "hashtable_numa_init requires a valid table pointer, key size and shard count\n");
+        return false;
+    }
+    t->node_count = node_count ? node_count : hashtable_numa_node_count();
+    t->shard_count = t->node_count * shards_per_node;
+    t->key_size = key_size;
+    t->value_size = value_size;
+    t->shards = (HTNumaShard *)calloc(t->shard_count, sizeof(HTNumaShard));
+    if (!t->shards) {
+        fprintf(stderr, "failed to allocate shards for HTNumaTable\n");
+        return false;
+    }
+    ht_index_t shard_capacity = base_capacity / t->shard_count + 1;
+    for (unsigned int i = 0; i < t->shard_count; i++) {
+        HTNumaShard *shard = &t->shards[i];
+        shard->node = i % t->node_count;
+        HTAllocator allocator = {numa_alloc, numa_realloc, numa_free, shard, HT_ALLOCATOR_USER};
+        if (!hashtable_init_with_allocator(&shard->table, key_size, value_size, shard_capacity, &allocator)) {
+            t->shard_count = i;
+            hashtable_numa_deinit(t);
+            return false;
+        }
+        pthread_mutex_init(&shard->lock, NULL);
+        atomic_init(&shard->local, 0);
+        atomic_init(&shard->remote, 0);
+    }
+    return true;
+}
+
+void hashtable_numa_deinit(HTNumaTable *t) {
+    if (!t || !t->shards) {
+        return;
+    }
+    for (unsigned int i = 0; i < t->shard_count; i++) {
+        hashtable_deinit(&t->shards[i].table);
+        pthread_mutex_destroy(&t->shards[i].lock);
+    }
+    free(t->shards);
+    t->shards = NULL;
+    t->shard_count = 0;
+}
+
+static inline unsigned int shard_idx(const HTNumaTable *t, const void *key) {
+    // fastrange on the top 32 bits
+    return (unsigned int)(((hashtable_hash_xxh3(key, t->key_size) >> 32) * t->shard_count) >> 32);
+}
+
+// locks the shard owning key and counts the access
+static HTNumaShard *lock_shard(HTNumaTable *t, const void *key) {
+    HTNumaShard *shard = &t->shards[shard_idx(t, key)];
+    bool local = shard->node == hashtable_numa_current_node() % t->node_count;
+    atomic_fetch_add_explicit(local ? &shard->local : &shard->remote, 1, memory_order_relaxed);
+    pthread_mutex_lock(&shard->lock);
+    return shard;
+}
+
+bool hashtable_numa_put(HTNumaTable *t, const void *key, void *value) {
+    HTNumaShard *shard = lock_shard(t, key);
+    bool put = hashtable_put(&shard->table, key, value);
+    pthread_mutex_unlock(&shard->lock);
+    return put;
+}
+
+bool hashtable_numa_get(HTNumaTable *t, const void *key, void *out_value) {
+    HTNumaShard *shard = lock_shard(t, key);
+    void *value = hashtable_find(&shard->table, key);
+    if (value && out_value) {
+        memcpy(out_value, value, t->value_size);
+    }
+    pthread_mutex_unlock(&shard->lock);
+    return value != NULL;
+}
+
+bool hashtable_numa_contains(HTNumaTable *t, const void *key) {
+    return hashtable_numa_get(t, key, NULL);
+}
+
+bool hashtable_numa_remove(HTNumaTable *t, const void *key) {
+    HTNumaShard *shard = lock_shard(t, key);
+    ht_index_t before = hashtable_count(&shard->table);
+    hashtable_remove(&shard->table, key);
+    bool removed = hashtable_count(&shard->table) < before;
+    pthread_mutex_unlock(&shard->lock);
+    return removed;
+}
+
+ht_index_t hashtable_numa_count(HTNumaTable *t) {
+    ht_index_t count = 0;
+    for (unsigned int i = 0; i < t->shard_count; i++) {
+        pthread_mutex_lock(&t->shards[i].lock);
+        count += hashtable_count(&t->shards[i].table);
+        pthread_mutex_unlock(&t->shards[i].lock);
+    }
+    return count;
+}
+
+unsigned int hashtable_numa_key_node(const HTNumaTable *t, const void *key) {
+    return t->shards[shard_idx(t, key)].node;
+}
+
+static HTNumaStats numa_stats(const HTNumaTable *t, int node) {
+    HTNumaStats stats = {0, 0};
+    for (unsigned int i = 0; i < t->shard_count; i++) {
+        if (node < 0 || t->shards[i].node == (unsigned int)node) {
+            stats.local += atomic_load_explicit(&t->shards[i].local, memory_order_relaxed);
+            stats.remote += atomic_load_explicit(&t->shards[i].remote, memory_order_relaxed);
+        }
+    }
+    return stats;
+}
+
+HTNumaStats hashtable_numa_stats(const HTNumaTable *t) {
+    return numa_stats(t, -1);
+}
+
+HTNumaStats hashtable_numa_node_stats(const HTNumaTable *t, unsigned int node) {
+    return numa_stats(t, (int)node);
+}
+
+void hashtable_numa_reset_stats(HTNumaTable *t) {
+    for (unsigned int i = 0; i < t->shard_count; i++) {
+        atomic_store_explicit(&t->shards[i].local, 0, memory_order_relaxed);
+        atomic_store_explicit(&t->shards[i].remote, 0, memory_order_relaxed);
+    }
+}
+
+unsigned int hashtable_numa_node_count(void) {
+    static atomic_uint node_count; // sysfs is read once, racing first calls read the same value
+    unsigned int cached = atomic_load_explicit(&node_count, memory_order_relaxed);
+    if (cached) {
+        return cached;
+    }
+    unsigned int count = 1;
+#ifdef __linux__
+    // e.g. "0" or "0-1" or "0,2-3", the highest online node bounds the node ids
+    FILE *f = fopen("/sys/devices/system/node/online", "r");
+    if (f) {
+        char line[256];
+        if (fgets(line, sizeof(line), f)) {
+            char *last = line;
+            for (char *c = line; *c; c++) {
+                if (*c == '-' || *c == ',') {
+                    last = c + 1;
+                }
+            }
+            count = (unsigned int)strtoul(last, NULL, 10) + 1;
+        }
+        fclose(f);
+    }
+#endif
+    atomic_store_explicit(&node_count, count, memory_order_relaxed);
+    return count;
+}
+
+unsigned int hashtable_numa_current_node(void) {
+    if (thread_node >= 0) {
+        return (unsigned int)thread_node;
+    }
+#if defined(__linux__) && defined(SYS_getcpu)
+    // sched_getcpu goes through the vDSO, the getcpu syscall for the node only runs after a migration
+    int cpu = sched_getcpu();
+    if (cpu >= 0 && cpu == last_cpu) {
+        return last_cpu_node;
+    }
+    unsigned int syscall_cpu, node;
+    if (syscall(SYS_getcpu, &syscall_cpu, &node, NULL) == 0) {
+        last_cpu = (int)syscall_cpu;
+        last_cpu_node = node;
+        return node;
+    }
+#endif
+    return 0;
+}
+
+void hashtable_numa_set_thread_node(unsigned int node) {
+    thread_node = (int)node;
+}
+
+bool hashtable_numa_pin_thread(unsigned int node) {
+    hashtable_numa_set_thread_node(node);
+#ifdef __linux__
+    char path[64];
+    snprintf(path, sizeof(path), "/sys/devices/system/node/node%u/cpulist", physical_node(node));
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        return false;
+    }
+    // e.g. "0-3,8-11"
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    unsigned int first, last;
+    while (fscanf(f, "%u", &first) == 1) {
+        last = first;
+        int sep = fgetc(f);
+        if (sep == '-') {
+            if (fscanf(f, "%u", &last) != 1) {
+                break;
+            }
+            sep = fgetc(f);
+        }
+        for (unsigned int cpu = first; cpu <= last && cpu < CPU_SETSIZE; cpu++) {
+            CPU_SET(cpu, &cpus);
+        }
+        if (sep != ',') {
+            break;
+        }
+    }
+    fclose(f);
+    return CPU_COUNT(&cpus) > 0 && pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus) == 0;
+#else
+    return false;
+#endif
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <pthread.h>
+#include <stdatomic.h>
+
+#include "hashtable.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * NUMA aware sharded table: shards_per_node Hashtables per NUMA node, each behind its own mutex and with its
+ * entry array and bitmap bound to its node (mbind with MPOL_PREFERRED). Key/value blocks are plain malloc and
+ * land on the node of the inserting thread by first touch.
+ *
+ * A key always lives in the same shard, chosen by its XXH3 hash (the shards themselves use XXH64 so the two
+ * stay independent). Local accesses come from routing: hashtable_numa_key_node tells a dispatcher which node
+ * owns a key so the work can be handed to a worker pinned there with hashtable_numa_pin_thread.
+ * Every operation counts as local or remote depending on the calling thread's node.
+ *
+ * node_count may exceed the machine's nodes to emulate a NUMA box, e.g. 2 on a single node machine: virtual
+ * node n is bound to physical node n % hashtable_numa_node_count() and threads pick their virtual node with
+ * hashtable_numa_set_thread_node. numactl --cpunodebind/--membind runs combine with it as usual.
+ * Linux only, elsewhere every shard uses plain malloc and every access is local to node 0.
+ */
+
+typedef struct HTNumaShard {
+    pthread_mutex_t lock;
+    Hashtable table;
+    unsigned int node; // virtual node
+    bool bound; // the entry array was mbind'ed to the node
+    atomic_ullong local;
+    atomic_ullong remote;
+} HTNumaShard;
+
+typedef struct HTNumaTable {
+    HTNumaShard *shards;
+    unsigned int shard_count;
+    unsigned int node_count;
+    size_t key_size;
+    size_t value_size;
+} HTNumaTable;
+
+typedef struct HTNumaStats {
+    unsigned long long local;
+    unsigned long long remote;
+} HTNumaStats;
+
+// node_count 0 uses the machine's nodes, base_capacity is split over the shards
+bool hashtable_numa_init(HTNumaTable *t, size_t key_size, size_t value_size, ht_index_t base_capacity,
+                         unsigned int node_count, unsigned int shards_per_node);
+void hashtable_numa_deinit(HTNumaTable *t);
+
+bool hashtable_numa_put(HTNumaTable *t, const void *key, void *value);
+// copies the value out under the shard lock, false when key is absent
+bool hashtable_numa_get(HTNumaTable *t, const void *key, void *out_value);
+bool hashtable_numa_contains(HTNumaTable *t, const void *key);
+// false when key is absent
+bool hashtable_numa_remove(HTNumaTable *t, const void *key);
+ht_index_t hashtable_numa_count(HTNumaTable *t);
+
+// virtual node owning key, for routing work to a worker on that node
+unsigned int hashtable_numa_key_node(const HTNumaTable *t, const void *key);
+
+// accesses so far, summed over every shard or just the shards of one virtual node
+HTNumaStats hashtable_numa_stats(const HTNumaTable *t);
+HTNumaStats hashtable_numa_node_stats(const HTNumaTable *t, unsigned int node);
+void hashtable_numa_reset_stats(HTNumaTable *t);
+
+// nodes of the machine (at least 1)
+unsigned int hashtable_numa_node_count(void);
+// virtual node of the calling thread: the one set below, otherwise the node of the CPU it runs on
+unsigned int hashtable_numa_current_node(void);
+void hashtable_numa_set_thread_node(unsigned int node);
+// restricts the calling thread to the CPUs of physical node node % hashtable_numa_node_count() and sets its
+// virtual node, false when the affinity could not be set (the virtual node is still set)
+bool hashtable_numa_pin_thread(unsigned int node);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,310 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "hashtable.h"
+
+/**
+ * Replays a workload trace recorded with HASHTABLE_TRACE (see hashtable_trace_start) against a fresh table and
+ * reports CSV throughput and latency percentiles, one row per operation type plus an "all" row.
+ *
+ * Every pass replays the whole trace back to back, the recorded inter-arrival times are not reproduced, the
+ * trace_ns column shows how long the recording took for comparison. The first pass is untimed per operation
+ * and gives the throughput, the second times every operation individually for the latency percentiles
+ * (clock_gettime overhead included).
+ *
+ * The default probing is compile time like the benchmark, `make replay` builds hashtable_replay_linear and
+ * hashtable_replay_quad, --probes replays once per listed strategy (hashtable_set_probe).
+ * The load factor is TARGET_LOAD_FACTOR, e.g. `make replay REPLAY_FLAGS=-DTARGET_LOAD_FACTOR=0.8`.
+ *
+ * usage: hashtable_replay trace.bin [--hashes xxh64,xxh3,int,djb2] [--probes linear,quadratic,double]
+ *                        [--capacity n] [--passes n] [--csv path]
+ * --capacity overrides the initial capacity recorded in the trace header.
+ */
+
+#define REPLAY_OPS 6 // HTTraceOp values, index 0 reports every op
+
+static const char *op_names[REPLAY_OPS] = {"all", "put", "find", "remove", "clear", "resize"};
+// indexed by HTHashKind
+static const char *hash_names[] = {"xxh64", "xxh3", "int", "djb2"};
+// indexed by HTProbeStrategy
+static const char *probe_names[] = {"linear", "quadratic", "double"};
+
+typedef struct ReplayOp {
+    uint8_t op;
+    ht_index_t capacity; // resize only
+    size_t key_offset; // into Trace.keys for put/find/remove
+} ReplayOp;
+
+typedef struct Trace {
+    size_t key_size; // bytes per replayed key, 8 for hashed key traces
+    size_t value_size;
+    uint32_t capacity;
+    bool hashed_keys;
+    uint64_t duration_ns;
+    ReplayOp *ops;
+    size_t op_count;
+    unsigned char *keys;
+} Trace;
+
+static inline uint64_t replay_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static bool read_u32(const unsigned char **pos, const unsigned char *end, uint32_t *out) {
+    if (end - *pos < 4) return false;
+    *out = (uint32_t)(*pos)[0] | (uint32_t)(*pos)[1] << 8 | (uint32_t)(*pos)[2] << 16 | (uint32_t)(*pos)[3] << 24;
+    *pos += 4;
+    return true;
+}
+
+static bool read_varint(const unsigned char **pos, const unsigned char *end, uint64_t *out) {
+    *out = 0;
+    for (unsigned int shift = 0; *pos < end && shift < 64; shift += 7) {
+        unsigned char byte = *(*pos)++;
+        *out |= (uint64_t)(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) return true;
+    }
+    return false;
+}
+
+// parses a whole trace file, a truncated last record (e.g. a process killed while tracing) is dropped
+static bool trace_load(Trace *trace, const char *path) {
+    memset(trace, 0, sizeof(*trace));
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        fprintf(stderr, "unable to open trace %s\n", path);
+        return false;
+    }
+    fseek(f, 0, SEEK_END);
+    long bytes = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    unsigned char *data = bytes > 0 ? (unsigned char *)malloc((size_t)bytes) : NULL;
+    bool read = data && fread(data, 1, (size_t)bytes, f) == (size_t)bytes;
+    fclose(f);
+    const size_t magic_len = sizeof(HT_TRACE_MAGIC) - 1;
+    if (!read || (size_t)bytes < magic_len + 16 || memcmp(data, HT_TRACE_MAGIC, magic_len) != 0) {
+        fprintf(stderr, "%s is not a hashtable trace\n", path);
+        free(data);
+        return false;
+    }
+    const unsigned char *pos = data + magic_len, *end = data + bytes;
+    uint32_t key_size, value_size, flags;
+    read_u32(&pos, end, &key_size);
+    read_u32(&pos, end, &value_size);
+    read_u32(&pos, end, &flags);
+    read_u32(&pos, end, &trace->capacity);
+    trace->hashed_keys = flags & HT_TRACE_HASHED_KEYS;
+    trace->key_size = trace->hashed_keys ? sizeof(uint64_t) : key_size;
+    trace->value_size = value_size;
+    // every record is at least 2 bytes, plenty of room for ops and keys
+    size_t max_ops = (size_t)(end - pos) / 2 + 1;
+    trace->ops = (ReplayOp *)malloc(max_ops * sizeof(ReplayOp));
+    trace->keys = (unsigned char *)malloc((size_t)(end - pos) + 1);
+    if (!trace->ops || !trace->keys || trace->key_size == 0) {
+        fprintf(stderr, "failed to allocate the replay buffers for %s\n", path);
+        free(data);
+        return false;
+    }
+    size_t key_bytes = 0;
+    while (pos < end) {
+        ReplayOp *op = &trace->ops[trace->op_count];
+        uint64_t delta, capacity;
+        op->op = *pos++;
+        op->key_offset = 0; // replay_op forms a key pointer for every op, keep it defined for CLEAR/RESIZE
+        op->capacity = 0;
+        if (!read_varint(&pos, end, &delta)) break;
+        if (op->op == HT_TRACE_PUT || op->op == HT_TRACE_FIND || op->op == HT_TRACE_REMOVE) {
+            if ((size_t)(end - pos) < trace->key_size) break;
+            op->key_offset = key_bytes;
+            memcpy(trace->keys + key_bytes, pos, trace->key_size);
+            key_bytes += trace->key_size;
+            pos += trace->key_size;
+        } else if (op->op == HT_TRACE_RESIZE) {
+            if (!read_varint(&pos, end, &capacity)) break;
+            op->capacity = (ht_index_t)capacity;
+        } else if (op->op != HT_TRACE_CLEAR) {
+            fprintf(stderr, "unknown trace op %u after %zu records, stopping there\n", op->op, trace->op_count);
+            break;
+        }
+        trace->duration_ns += delta;
+        trace->op_count++;
+    }
+    free(data);
+    return true;
+}
+
+static void trace_free(Trace *trace) {
+    free(trace->ops);
+    free(trace->keys);
+}
+
+static volatile uintptr_t replay_sink; // keeps finds from being optimized away
+
+static inline void replay_op(Hashtable *ht, const Trace *trace, const ReplayOp *op, void *value) {
+    const unsigned char *key = trace->keys + op->key_offset;
+    switch (op->op) {
+    case HT_TRACE_PUT: hashtable_put(ht, key, value); break;
+    case HT_TRACE_FIND: replay_sink += (uintptr_t)hashtable_find(ht, key); break;
+    case HT_TRACE_REMOVE: hashtable_remove(ht, key); break;
+    case HT_TRACE_CLEAR: hashtable_clear(ht); break;
+    case HT_TRACE_RESIZE: hashtable_resize(ht, op->capacity); break;
+    default: break;
+    }
+}
+
+static int compare_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+static uint64_t percentile(const uint64_t *sorted, size_t count, double p) {
+    if (count == 0) return 0;
+    return sorted[(size_t)(p * (count - 1) + 0.5)];
+}
+
+static bool replay_table_init(Hashtable *ht, const Trace *trace, HTHashKind hash, HTProbeStrategy probe,
+                              ht_index_t capacity) {
+    if (!hashtable_init(ht, trace->key_size, trace->value_size, capacity)) {
+        return false;
+    }
+    return hashtable_set_hash(ht, hash, NULL) && hashtable_set_probe(ht, probe);
+}
+
+// one configuration: a throughput pass and a latency pass, each on a fresh table
+static void replay(const Trace *trace, HTHashKind hash, HTProbeStrategy probe, ht_index_t capacity, unsigned int passes,
+                   FILE *csv) {
+    void *value = calloc(1, trace->value_size + 1);
+    uint64_t *latencies = (uint64_t *)malloc((trace->op_count + 1) * sizeof(uint64_t));
+    uint8_t *kinds = (uint8_t *)malloc(trace->op_count + 1);
+    uint64_t *sorted = (uint64_t *)malloc((trace->op_count + 1) * sizeof(uint64_t));
+    Hashtable ht;
+    if (!value || !latencies || !kinds || !sorted) {
+        fprintf(stderr, "failed to allocate replay buffers\n");
+        goto out;
+    }
+    uint64_t wall_ns = 0;
+    for (unsigned int p = 0; p < passes; p++) {
+        if (!replay_table_init(&ht, trace, hash, probe, capacity)) goto out;
+        uint64_t start = replay_now_ns();
+        for (size_t i = 0; i < trace->op_count; i++) {
+            replay_op(&ht, trace, &trace->ops[i], value);
+        }
+        wall_ns += replay_now_ns() - start;
+        hashtable_deinit(&ht);
+    }
+
+    if (!replay_table_init(&ht, trace, hash, probe, capacity)) goto out;
+    for (size_t i = 0; i < trace->op_count; i++) {
+        uint64_t start = replay_now_ns();
+        replay_op(&ht, trace, &trace->ops[i], value);
+        latencies[i] = replay_now_ns() - start;
+        kinds[i] = trace->ops[i].op;
+    }
+    hashtable_deinit(&ht);
+
+    for (unsigned int op = 0; op < REPLAY_OPS; op++) {
+        size_t count = 0;
+        uint64_t total = 0;
+        for (size_t i = 0; i < trace->op_count; i++) {
+            if (op == 0 || kinds[i] == op) {
+                sorted[count++] = latencies[i];
+                total += latencies[i];
+            }
+        }
+        if (count == 0) continue;
+        qsort(sorted, count, sizeof(uint64_t), compare_u64);
+        // the all row's throughput comes from the untimed passes
+        double ns_per_op = op == 0 ? (double)wall_ns / ((double)passes * count) : (double)total / count;
+        fprintf(csv, "%s,%s,%llu,%s,%zu,%llu,%.3f,%.2f,%llu,%llu,%llu,%llu,%llu\n",
+                probe_names[probe], hash_names[hash], (unsigned long long)capacity, op_names[op], count,
+                (unsigned long long)trace->duration_ns, ns_per_op > 0 ? 1000.0 / ns_per_op : 0, ns_per_op,
+                (unsigned long long)percentile(sorted, count, 0.50),
+                (unsigned long long)percentile(sorted, count, 0.90),
+                (unsigned long long)percentile(sorted, count, 0.99),
+                (unsigned long long)percentile(sorted, count, 0.999),
+                (unsigned long long)sorted[count - 1]);
+    }
+    fflush(csv);
+out:
+    free(value);
+    free(latencies);
+    free(kinds);
+    free(sorted);
+}
+
+// indexes into names of the comma separated names in arg
+static unsigned int parse_names(const char *arg, const char **names, unsigned int name_count, int *out, unsigned int max) {
+    unsigned int count = 0;
+    while (*arg && count < max) {
+        size_t len = strcspn(arg, ",");
+        for (unsigned int n = 0; n < name_count; n++) {
+            if (strlen(names[n]) == len && strncmp(arg, names[n], len) == 0) {
+                out[count++] = (int)n;
+            }
+        }
+        arg += len + (arg[len] == ',');
+    }
+    return count;
+}
+
+int main(int argc, char **argv) {
+    const char *path = NULL;
+    int hashes[8] = {HT_HASH_XXH64};
+    unsigned int hash_count = 1;
+    int probes[8] = {HT_PROBE_DEFAULT};
+    unsigned int probe_count = 1;
+    ht_index_t capacity = 0;
+    unsigned int passes = 1;
+    FILE *csv = stdout;
+    for (int i = 1; i < argc; i++) {
+        const char *next = i + 1 < argc ? argv[i + 1] : "";
+        if (strcmp(argv[i], "--hashes") == 0) {
+            hash_count = parse_names(next, hash_names, sizeof(hash_names) / sizeof(hash_names[0]), hashes, 8), i++;
+        } else if (strcmp(argv[i], "--probes") == 0) {
+            probe_count = parse_names(next, probe_names, sizeof(probe_names) / sizeof(probe_names[0]), probes, 8), i++;
+        } else if (strcmp(argv[i], "--capacity") == 0) {
+            capacity = (ht_index_t)strtoull(next, NULL, 10), i++;
+        } else if (strcmp(argv[i], "--passes") == 0) {
+            passes = (unsigned int)strtoul(next, NULL, 10), i++;
+        } else if (strcmp(argv[i], "--csv") == 0) {
+            csv = fopen(next, "w"), i++;
+            if (!csv) {
+                fprintf(stderr, "unable to open %s for writing\n", next);
+                return 1;
+            }
+        } else if (argv[i][0] != '-' && !path) {
+            path = argv[i];
+        } else {
+            fprintf(stderr, "unknown option %s, see the usage comment in hashtable_replay.c\n", argv[i]);
+            return 1;
+        }
+    }
+    Trace trace;
+    if (!path || !trace_load(&trace, path)) {
+        fprintf(stderr, "usage: hashtable_replay trace.bin [--hashes ..] [--probes ..] [--capacity n] [--passes n] [--csv path]\n");
+        return 1;
+    }
+    if (capacity == 0) {
+        capacity = trace.capacity > 0 ? trace.capacity : 1;
+    }
+    if (passes == 0) {
+        passes = 1;
+    }
+    fprintf(csv, "probing,hash,capacity,op,ops,trace_ns,mops_per_s,ns_per_op,p50_ns,p90_ns,p99_ns,p999_ns,max_ns\n");
+    for (unsigned int h = 0; h < hash_count; h++) {
+        for (unsigned int p = 0; p < probe_count; p++) {
+            replay(&trace, (HTHashKind)hashes[h], (HTProbeStrategy)probes[p], capacity, passes, csv);
+        }
+    }
+    trace_free(&trace);
+    if (csv != stdout) {
+        fclose(csv);
+    }
+    return 0;
+}
@@ -10,6 +10,106 @@ extern char *test_arr[]; // test_cases.h
 #define QUAD_PROBING
 #define TARGET_LOAD_FACTOR 0.65
 #include "hashtable.h"
+#include "hashtable_define.h"
+#include "ordered_hashtable.h"
+#include "hashtable_export.h"
+#include "hashtable_numa.h"
+
+HASHTABLE_DEFINE(inttable, int, int, HASHTABLE_HASH_INT, HASHTABLE_EQ_SCALAR)
+
+static void mark_scanned(const Hashentry *entry, void *ctx) {
+    ((int *)ctx)[*(int *)entry->key]++;
+}
+
+static bool keep_multiples(const void *key, void *value, void *ctx) {
+    (void)value;
+    return *(const int *)key % *(int *)ctx == 0;
+}
+
+static void sum_keys_per_thread(const Hashentry *entry, unsigned int thread_idx, void *ctx) {
+    ((long *)ctx)[thread_idx] += *(int *)entry->key;
+}
+
+static uint64_t identity_hash(const void *key, size_t key_size) {
+    (void)key_size;
+    return (uint64_t)*(const int *)key; // weak on purpose, the table finalizes custom hashes
+}
+
+typedef struct CountingAllocator {
+    long live;
+    size_t live_bytes;
+    size_t reallocs;
+} CountingAllocator;
+
+static void *counting_alloc(void *ctx, size_t size) {
+    ((CountingAllocator *)ctx)->live++;
+    ((CountingAllocator *)ctx)->live_bytes += size;
+    return malloc(size);
+}
+
+static void *counting_realloc(void *ctx, void *ptr, size_t old_size, size_t new_size) {
+    ((CountingAllocator *)ctx)->reallocs++;
+    ((CountingAllocator *)ctx)->live_bytes += new_size - old_size;
+    return realloc(ptr, new_size);
+}
+
+static void counting_free(void *ctx, void *ptr, size_t size) {
+    if (ptr) {
+        ((CountingAllocator *)ctx)->live--;
+        ((CountingAllocator *)ctx)->live_bytes -= size;
+    }
+    free(ptr);
+}
+
+typedef struct NumaWorker {
+    HTNumaTable *table;
+    unsigned int node;
+    int key_count;
+} NumaWorker;
+
+// inserts only the keys owned by the worker's node, like a dispatcher routing keys to node local workers
+static void *numa_worker(void *arg) {
+    NumaWorker *worker = (NumaWorker *)arg;
+    hashtable_numa_set_thread_node(worker->node);
+    for (int i = 0; i < worker->key_count; i++) {
+        if (hashtable_numa_key_node(worker->table, &i) == worker->node) {
+            int value = i * 7;
+            assert(hashtable_numa_put(worker->table, &i, &value));
+        }
+    }
+    return NULL;
+}
+
+// a table written by one thread while another scrapes the registry
+typedef struct ScrapedTable {
+    pthread_mutex_t lock;
+    Hashtable *table;
+    int locks; // scrapes that took the lock
+} ScrapedTable;
+
+static void scraped_lock(void *ctx) {
+    pthread_mutex_lock(&((ScrapedTable *)ctx)->lock);
+    ((ScrapedTable *)ctx)->locks++;
+}
+
+static void scraped_unlock(void *ctx) {
+    pthread_mutex_unlock(&((ScrapedTable *)ctx)->lock);
+}
+
+static void *scraped_writer(void *arg) {
+    ScrapedTable *scraped = (ScrapedTable *)arg;
+    for (int i = 0; i < 20000; i++) {
+        pthread_mutex_lock(&scraped->lock);
+        assert(hashtable_put(scraped->table, &i, &i)); // resizes while the registry is scraped
+        pthread_mutex_unlock(&scraped->lock);
+    }
+    return NULL;
+}
+
+static bool sum_values(void *value, void *ctx) {
+    *(int *)ctx += *(int *)value;
+    return true;
+}
 
 
 int main() {
@@ -53,7 +153,7 @@ int main() {
 
 
     for (int i = 0; i < 250; i++) {
-        unsigned int old_cnt = ht1->count;
+        ht_index_t old_cnt = ht1->count;
         hashtable_remove(ht1, &i);
         assert(ht1->count == old_cnt -1);
         assert(hashtable_contains(ht1, &i) == false);
@@ -74,11 +174,27 @@ int main() {
     }
 
     assert(itr_cnt == hashtable_count(ht1));
-    printf("Passed tests for HTIterator called to exhasution, all %u key/val pairs found\n", ht1->count);
+    printf("Passed tests for HTIterator called to exhasution, all %llu key/val pairs found\n", (unsigned long long)ht1->count);
+
+    // occupancy bitmap mirrors ENTRY_USED, iteration over a sparse table still finds every entry
+    for (ht_index_t i = 0; i < ht1->capacity; i++) {
+        bool bit = (ht1->used_bits[i / 64] >> (i % 64)) & 1;
+        assert(bit == (ht1->arr[i].state == ENTRY_USED));
+    }
+    for (int i = 250; i < 990; i++) {
+        hashtable_remove(ht1, &i);
+    }
+    itr_cnt = 0;
+    for (const Hashentry *entry = HTIterator_start(&itr, ht1); entry != NULL; entry = HTIterator_next(&itr)) {
+        assert(*(int *)entry->key >= 990);
+        itr_cnt++;
+    }
+    assert(itr_cnt == 10 && hashtable_count(ht1) == 10);
+    printf("Passed tests for occupancy bitmap and HTIterator over a sparse table\n");
 
 
     // alternative way to iterate all key value pairs
-    for (unsigned int i = 0; i < ht1->capacity; i++) {
+    for (ht_index_t i = 0; i < ht1->capacity; i++) {
         Hashentry entry = ht1->arr[i];
         if (entry.state == ENTRY_USED) {
 
@@ -87,6 +203,705 @@ int main() {
 
 
 
+    inttable typed;
+    assert(inttable_init(&typed, 10));
+    for (int i = 0; i < 1000; i++) {
+        assert(inttable_put(&typed, i, i * 2));
+    }
+    assert(inttable_count(&typed) == 1000);
+    for (int i = 0; i < 1000; i++) {
+        int *out_find = inttable_find(&typed, i);
+        assert(out_find != NULL);
+        assert(*out_find == i * 2);
+    }
+    for (int i = 0; i < 500; i++) {
+        assert(inttable_remove(&typed, i));
+        assert(!inttable_contains(&typed, i));
+    }
+    assert(inttable_put(&typed, 999, -1));
+    assert(*inttable_find(&typed, 999) == -1);
+    inttable_iterator typed_itr;
+    int typed_itr_cnt = 0;
+    for (const inttable_entry *entry = inttable_iterator_start(&typed_itr, &typed); entry; entry = inttable_iterator_next(&typed_itr)) {
+        assert(entry->key >= 500);
+        typed_itr_cnt++;
+    }
+    assert(typed_itr_cnt == 500 && inttable_count(&typed) == 500);
+    inttable_deinit(&typed);
+    assert(hashtable_define_alloc(SIZE_MAX / 2, 4) == NULL); // the byte count would wrap
+    printf("Passed tests for HASHTABLE_DEFINE typed table put/find/remove/iterate\n");
+
+
+    Hashtable *set1 = hashtableset_create(int, 10);
+    Hashtable *set2 = hashtableset_create(int, 10);
+    int set_keys[1000];
+    for (int i = 0; i < 1000; i++) {
+        set_keys[i] = i;
+    }
+    assert(hashtableset_insert_all(set1, set_keys, 500)); // 0..499
+    assert(hashtableset_insert_all(set2, set_keys + 250, 750)); // 250..999
+    assert(hashtable_count(set1) == 500 && hashtable_count(set2) == 750);
+    assert(hashtableset_insert(set1, &set_keys[0])); // duplicate insert is a no-op
+    assert(hashtable_count(set1) == 500);
+    for (ht_index_t i = 0; i < set1->capacity; i++) {
+        assert(set1->arr[i].value == NULL);
+    }
+    Hashtable *set_union = hashtableset_create(int, 10);
+    assert(hashtableset_union(set_union, set1));
+    assert(hashtableset_union(set_union, set2));
+    assert(hashtable_count(set_union) == 1000);
+    assert(hashtableset_difference(set1, set2)); // 0..249
+    assert(hashtable_count(set1) == 250);
+    assert(hashtableset_contains(set1, &set_keys[0]) && !hashtableset_contains(set1, &set_keys[250]));
+    assert(hashtableset_intersect(set2, set_union));
+    assert(hashtable_count(set2) == 750);
+    hashtable_get(set2, &set_keys[500], NULL); // sets have no value to copy out
+    Hashtable *set_short = hashtableset_create(short, 10);
+    Hashtable *not_a_set = hashtable_create(int, int, 10);
+    assert(!hashtableset_intersect(set2, set_short) && !hashtableset_difference(set2, set_short));
+    assert(!hashtableset_intersect(set2, not_a_set) && !hashtableset_difference(set2, not_a_set));
+    assert(!hashtableset_union(set2, not_a_set));
+    assert(hashtable_count(set2) == 750);
+    hashtable_destroy(set_short);
+    hashtable_destroy(not_a_set);
+    assert(hashtableset_erase(set2, &set_keys[999]) && !hashtableset_erase(set2, &set_keys[999]));
+    assert(!hashtableset_contains(set2, &set_keys[999]));
+    hashtable_destroy(set1);
+    hashtable_destroy(set2);
+    hashtable_destroy(set_union);
+    printf("Passed tests for set mode insert/contains/erase and bulk set operations\n");
+
+
+    Hashtable *multi = hashtable_create_multimap(int, int, 10);
+    for (int dup = 0; dup < 3; dup++) {
+        for (int i = 0; i < 200; i++) {
+            int value = i * 10 + dup;
+            assert(hashtable_put(multi, &i, &value)); // grows through several resizes
+        }
+    }
+    assert(hashtable_count(multi) == 600);
+    for (int i = 0; i < 200; i++) {
+        int sum = 0;
+        assert(hashtable_find_all(multi, &i, sum_values, &sum) == 3);
+        assert(sum == i * 30 + 3);
+    }
+    int multi_key = 7;
+    HTEqualRange range;
+    int range_cnt = 0;
+    for (const Hashentry *entry = HTEqualRange_start(&range, multi, &multi_key); entry; entry = HTEqualRange_next(&range)) {
+        assert(*(int *)entry->key == 7 && *(int *)entry->value / 10 == 7);
+        range_cnt++;
+    }
+    assert(range_cnt == 3);
+    assert(hashtable_remove_all(multi, &multi_key) == 3);
+    assert(hashtable_count_key(multi, &multi_key) == 0);
+    assert(hashtable_count(multi) == 597);
+    hashtable_destroy(multi);
+    printf("Passed tests for multimap duplicate keys, find_all, equal range and remove_all\n");
+
+
+    OrderedHashtable oht;
+    assert(ordered_hashtable_init(&oht, sizeof(int), sizeof(int), 10));
+    for (int i = 0; i < 1000; i++) {
+        int key = 999 - i; // insertion order differs from key order
+        assert(ordered_hashtable_put(&oht, &key, &i));
+    }
+    assert(oht.index_width == 2);
+    for (int i = 0; i < 1000; i += 2) {
+        assert(ordered_hashtable_remove(&oht, &i));
+    }
+    int reinserted = 0, reinserted_val = -1;
+    assert(ordered_hashtable_put(&oht, &reinserted, &reinserted_val)); // goes to the end again
+    assert(ordered_hashtable_count(&oht) == 501);
+    for (int i = 1; i < 1000; i += 2) {
+        int *out_find = (int *)ordered_hashtable_find(&oht, &i);
+        assert(out_find != NULL && *out_find == 999 - i);
+    }
+    OHTIterator oitr;
+    int prev_key = 1000, ordered_cnt = 0;
+    for (const OrderedEntry *entry = OHTIterator_start(&oitr, &oht); entry; entry = OHTIterator_next(&oitr)) {
+        int key = *(const int *)entry->key;
+        if (ordered_cnt == 500) {
+            assert(key == 0 && *(int *)entry->value == -1);
+        } else {
+            assert(key < prev_key && key % 2 == 1);
+        }
+        prev_key = key;
+        ordered_cnt++;
+    }
+    assert(ordered_cnt == 501);
+    ordered_hashtable_deinit(&oht);
+    OrderedHashtable oset;
+    assert(ordered_hashtable_init(&oset, sizeof(int), 0, 10));
+    int oset_key = 7;
+    assert(ordered_hashtable_put(&oset, &oset_key, NULL));
+    assert(ordered_hashtable_put(&oset, &oset_key, NULL)); // re-put of a set key has no value to copy
+    assert(ordered_hashtable_count(&oset) == 1);
+    ordered_hashtable_deinit(&oset);
+    printf("Passed tests for OrderedHashtable insertion ordered put/find/remove/iterate\n");
+
+
+    Hashtable *scanned = hashtable_create(int, int, 10);
+    for (int i = 0; i < 500; i++) {
+        assert(hashtable_put(scanned, &i, &i));
+    }
+    int scan_visits[2000] = {0};
+    uint64_t cursor = 0;
+    int scan_calls = 0, next_key = 500;
+    do {
+        cursor = hashtable_scan(scanned, cursor, 16, mark_scanned, scan_visits);
+        // keep inserting between calls so the table resizes mid scan
+        for (int i = 0; i < 40 && next_key < 2000; i++, next_key++) {
+            assert(hashtable_put(scanned, &next_key, &next_key));
+        }
+        scan_calls++;
+    } while (cursor != 0);
+    assert(scan_calls > 1);
+    for (int i = 0; i < 500; i++) {
+        assert(scan_visits[i] == 1);
+    }
+    hashtable_destroy(scanned);
+    printf("Passed tests for hashtable_scan visiting every entry once across resizes\n");
+
+
+    Hashtable *purged = hashtable_create(int, int, 10);
+    for (int i = 0; i < 1000; i++) {
+        assert(hashtable_put(purged, &i, &i));
+    }
+    for (const Hashentry *entry = HTIterator_start(&itr, purged); entry != NULL; entry = HTIterator_next(&itr)) {
+        if (*(int *)entry->key % 2 == 1) {
+            assert(HTIterator_erase(&itr));
+            assert(!HTIterator_erase(&itr)); // already erased
+        }
+    }
+    assert(hashtable_count(purged) == 500);
+    int divisor = 4;
+    ht_index_t purged_cap = purged->capacity;
+    assert(hashtable_retain(purged, keep_multiples, &divisor) == 250);
+    assert(hashtable_count(purged) == 250 && purged->capacity == purged_cap);
+    for (ht_index_t i = 0; i < purged->capacity; i++) {
+        assert(purged->arr[i].state != ENTRY_DELETED);
+    }
+    for (int i = 0; i < 1000; i++) {
+        assert(hashtable_contains(purged, &i) == (i % 4 == 0));
+    }
+    hashtable_destroy(purged);
+    // linear tables start at the exact requested size (100 unless hashtable.c is built with QUAD_PROBING)
+    Hashtable *linear_purged = hashtable_create(int, int, 100);
+    assert(hashtable_set_probe(linear_purged, HT_PROBE_LINEAR));
+    purged_cap = linear_purged->capacity;
+    for (int i = 0; i < 50; i++) {
+        assert(hashtable_put(linear_purged, &i, &i));
+    }
+    assert(hashtable_retain(linear_purged, keep_multiples, &divisor) == 37);
+    assert(hashtable_count(linear_purged) == 13 && linear_purged->capacity == purged_cap); // not next_prime(100)
+    hashtable_destroy(linear_purged);
+    printf("Passed tests for HTIterator_erase and hashtable_retain\n");
+
+
+    Hashtable *big = hashtable_create(int, int, 10);
+    long expected_sum = 0;
+    for (int i = 0; i < 100000; i++) {
+        assert(hashtable_put(big, &i, &i));
+        expected_sum += i;
+    }
+    long thread_sums[4] = {0};
+    assert(hashtable_foreach_parallel(big, sum_keys_per_thread, thread_sums, 4));
+    assert(thread_sums[0] + thread_sums[1] + thread_sums[2] + thread_sums[3] == expected_sum);
+    HTSlotRange lower, upper;
+    HTSlotRange_init(&lower, big, 0, big->capacity);
+    assert(HTSlotRange_split(&lower, &upper));
+    assert(lower.end == upper.begin && upper.end == big->capacity);
+    unsigned int range_total = 0;
+    while (HTSlotRange_next(&lower)) range_total++;
+    while (HTSlotRange_next(&upper)) range_total++;
+    assert(range_total == hashtable_count(big));
+    hashtable_destroy(big);
+    printf("Passed tests for hashtable_foreach_parallel and HTSlotRange splitting\n");
+
+
+    HTHashKind hash_kinds[] = {HT_HASH_XXH3, HT_HASH_INT, HT_HASH_DJB2, HT_HASH_CUSTOM, HT_HASH_XXH64};
+    Hashtable *hashed = hashtable_create(int, int, 10);
+    for (int i = 0; i < 200; i++) {
+        assert(hashtable_put(hashed, &i, &i));
+    }
+    for (unsigned int k = 0; k < sizeof(hash_kinds) / sizeof(hash_kinds[0]); k++) {
+        // switching the hash of a populated table rehashes every entry
+        assert(hashtable_set_hash(hashed, hash_kinds[k], identity_hash));
+        for (int i = 0; i < 200; i++) {
+            int *out_find = (int *)hashtable_find(hashed, &i);
+            assert(out_find != NULL && *out_find == i);
+            assert(hashtable_probe_length(hashed, &i) >= 1);
+        }
+        int missing = 1000;
+        assert(hashtable_probe_length(hashed, &missing) == 0);
+    }
+    assert(!hashtable_set_hash(hashed, HT_HASH_CUSTOM, NULL));
+    hashtable_destroy(hashed);
+    printf("Passed tests for per table hash function selection\n");
+
+
+    Hashtable *measured = hashtable_create(uint64_t, uint32_t, 64);
+    HTMemoryUsage usage = hashtable_memory_usage(measured);
+    assert(usage.total_bytes == usage.entry_array_bytes + usage.metadata_bytes);
+    assert(usage.bytes_per_element == 0.0);
+    for (uint64_t i = 0; i < 40; i++) {
+        uint32_t v = (uint32_t)i;
+        assert(hashtable_put(measured, &i, &v));
+    }
+    for (uint64_t i = 0; i < 10; i++) {
+        hashtable_remove(measured, &i);
+    }
+    usage = hashtable_memory_usage(measured);
+    assert(measured->tombstones == 10);
+    HTMemoryUsage estimate = hashtable_memory_estimate(measured);
+    assert(estimate.tombstones == 10 && estimate.empty_slot_bytes == usage.empty_slot_bytes);
+    assert(estimate.total_bytes - estimate.malloc_overhead_bytes == usage.total_bytes - usage.malloc_overhead_bytes);
+    assert(usage.entry_array_bytes == measured->capacity * sizeof(Hashentry));
+    assert(usage.key_bytes == 30 * sizeof(uint64_t) && usage.value_bytes == 30 * sizeof(uint32_t));
+    assert(usage.malloc_overhead_bytes > 0);
+    assert(usage.tombstones == 10 && usage.tombstone_slot_bytes == 10 * sizeof(Hashentry));
+    assert(usage.empty_slot_bytes + usage.tombstone_slot_bytes + 30 * sizeof(Hashentry) == usage.entry_array_bytes);
+    assert(usage.total_bytes == usage.entry_array_bytes + usage.metadata_bytes + usage.key_bytes +
+                                usage.value_bytes + usage.malloc_overhead_bytes);
+    assert(usage.bytes_per_element == (double)usage.total_bytes / 30);
+    hashtable_destroy(measured);
+    printf("Passed tests for hashtable_memory_usage\n");
+
+
+    CountingAllocator counter = {0, 0, 0};
+    HTAllocator counting = {counting_alloc, counting_realloc, counting_free, &counter};
+    Hashtable tracked;
+    assert(hashtable_init_with_allocator(&tracked, sizeof(int), sizeof(int), 8, &counting));
+    assert(tracked.allocator.kind == HT_ALLOCATOR_USER);
+    for (int i = 0; i < 500; i++) {
+        assert(hashtable_put(&tracked, &i, &i));
+    }
+    for (int i = 0; i < 500; i += 2) {
+        hashtable_remove(&tracked, &i);
+    }
+    assert(counter.live == 2 + 2 * 250); // entry array, bitmap and a key/value block per live entry
+    assert(counter.reallocs > 0); // each resize grew the bitmap in place
+    usage = hashtable_memory_usage(&tracked);
+    assert(usage.malloc_overhead_bytes == 0);
+    hashtable_deinit(&tracked);
+    assert(counter.live == 0 && counter.live_bytes == 0);
+
+    Hashtable arena_table;
+    assert(hashtable_init_arena(&arena_table, sizeof(int), sizeof(long), 8));
+    assert(arena_table.allocator.kind == HT_ALLOCATOR_SLAB);
+    for (int i = 0; i < 2000; i++) {
+        long v = i * 3L;
+        assert(hashtable_put(&arena_table, &i, &v));
+    }
+    size_t reserved = hashtable_slab_arena_reserved(arena_table.arena);
+    assert(reserved > 2000 * (8 + 8));
+    for (int i = 0; i < 2000; i += 2) {
+        hashtable_remove(&arena_table, &i);
+    }
+    for (int i = 0; i < 2000; i += 2) { // refilled from the free lists
+        long v = -i;
+        assert(hashtable_put(&arena_table, &i, &v));
+    }
+    assert(hashtable_slab_arena_reserved(arena_table.arena) == reserved);
+    for (int i = 0; i < 2000; i++) {
+        long *v = (long *)hashtable_find(&arena_table, &i);
+        assert(v && *v == (i % 2 ? i * 3L : -i));
+    }
+    usage = hashtable_memory_usage(&arena_table);
+    assert(usage.key_bytes + usage.value_bytes + usage.malloc_overhead_bytes == reserved);
+    hashtable_deinit(&arena_table);
+
+    // values above HT_SLAB_MAX_BLOCK bypass the arena's chunks and are freed one by one
+    typedef struct { char bytes[512]; } LargeValue;
+    Hashtable large_arena;
+    assert(hashtable_init_arena(&large_arena, sizeof(int), sizeof(LargeValue), 8));
+    LargeValue large;
+    for (int i = 0; i < 100; i++) {
+        memset(large.bytes, i, sizeof(large.bytes));
+        assert(hashtable_put(&large_arena, &i, &large));
+    }
+    usage = hashtable_memory_usage(&large_arena);
+    assert(usage.value_bytes == 100 * sizeof(LargeValue) && usage.malloc_overhead_bytes < usage.total_bytes);
+    assert(usage.total_bytes >= usage.entry_array_bytes + usage.key_bytes + usage.value_bytes);
+    hashtable_clear(&large_arena);
+    assert(hashtable_count(&large_arena) == 0);
+    for (int i = 0; i < 100; i++) {
+        memset(large.bytes, i, sizeof(large.bytes));
+        assert(hashtable_put(&large_arena, &i, &large));
+    }
+    assert(((LargeValue *)hashtable_find(&large_arena, &(int){42}))->bytes[511] == 42);
+    hashtable_deinit(&large_arena);
+
+    HTSlabArena *shared = hashtable_slab_arena_create();
+    HTAllocator slab = hashtable_slab_allocator(shared);
+    Hashtable left, right;
+    assert(hashtable_init_with_allocator(&left, 24, sizeof(int), 8, &slab));
+    assert(hashtable_init_with_allocator(&right, sizeof(int), 100, 8, &slab));
+    assert(left.allocator.kind == HT_ALLOCATOR_SLAB && right.allocator.kind == HT_ALLOCATOR_SLAB);
+    for (int i = 0; i < 300; i++) {
+        char key[24] = {0};
+        char value[100];
+        snprintf(key, sizeof(key), "key-%d", i);
+        memset(value, i & 0xff, sizeof(value));
+        assert(hashtable_put(&left, key, &i));
+        assert(hashtable_put(&right, &i, value));
+    }
+    for (int i = 0; i < 300; i++) {
+        char key[24] = {0};
+        snprintf(key, sizeof(key), "key-%d", i);
+        assert(*(int *)hashtable_find(&left, key) == i);
+        assert(((unsigned char *)hashtable_find(&right, &i))[99] == (i & 0xff));
+    }
+    hashtable_deinit(&left);
+    hashtable_deinit(&right);
+    hashtable_slab_arena_destroy(shared);
+    printf("Passed tests for custom allocators and the slab arena\n");
+
+
+    assert(is_prime(4294967291u) && !is_prime(4294967293u)); // largest 32 bit prime, i * i must not overflow
+    assert(next_prime(4294967280u) == 4294967291u);
+#ifdef HASHTABLE_64BIT_INDEX
+    assert(sizeof(ht_index_t) == 8 && next_prime(4294967292u) == 4294967311ull);
+#else
+    assert(next_prime(4294967292u) == 0); // no 32 bit prime left, resizes past it fail instead of wrapping
+    assert(HT_PRIME_MAX == 4294967291u && next_prime(HT_PRIME_MAX) == HT_PRIME_MAX); // where growth saturates
+#endif
+    assert(ht_mulhi64(UINT64_MAX, UINT64_MAX) == UINT64_MAX - 1 && ht_mulhi64(UINT64_C(1) << 63, 6) == 3);
+    assert(ht_mulhi64(UINT64_C(0x123456789abcdef0), UINT64_C(0xfedcba9876543210)) == UINT64_C(0x121fa00ad77d7422));
+    uint64_t big_k = (UINT64_C(1) << 40) + 12345;
+    assert(ht_mulmod64(big_k, big_k, UINT64_C(18446744073709551557)) == UINT64_C(27146942246055089));
+    printf("Passed tests for the capacity index limits\n");
+
+
+    // QUAD_PROBING is defined above: the alternating +-k^2 sequence must reach every slot of a prime = 3 mod 4 table
+    const ht_index_t quad_primes[] = {3, 7, 11, 19, 23, 1019, 10007};
+    for (unsigned int p = 0; p < sizeof(quad_primes) / sizeof(quad_primes[0]); p++) {
+        ht_index_t cap = quad_primes[p];
+        char *seen = calloc(cap, 1);
+        for (ht_index_t start = 0; start < cap; start += cap / 3 + 1) {
+            memset(seen, 0, cap);
+            for (ht_index_t x = 0; x < cap; x++) {
+                ht_index_t idx = probe_idx(start, x, cap);
+                assert(idx < cap && !seen[idx]);
+                seen[idx] = 1;
+            }
+        }
+        free(seen);
+    }
+#ifdef HASHTABLE_64BIT_INDEX
+    // k = 2^32 + 1 squares past 64 bits: (2^64 + 2^33 + 1) mod (2^61 - 1) = 2^33 + 9
+    assert(probe_idx(0, ((ht_index_t)1 << 33) + 1, ((ht_index_t)1 << 61) - 1) == ((ht_index_t)1 << 33) + 9);
+#endif
+    for (ht_index_t desired = 1; desired < 200; desired += 7) {
+        ht_index_t cap = hashtable_probe_capacity(desired);
+        assert(cap >= desired && is_prime(cap));
+    }
+    printf("Passed tests for full coverage probe sequences\n");
+
+
+    const HTProbeStrategy strategies[] = {HT_PROBE_LINEAR, HT_PROBE_QUADRATIC, HT_PROBE_DOUBLE};
+    for (unsigned int s = 0; s < sizeof(strategies) / sizeof(strategies[0]); s++) {
+        Hashtable *probed = hashtable_create(int, int, 10);
+        assert(hashtable_set_probe(probed, strategies[s]) && probed->probe == strategies[s]);
+        assert(strategies[s] == HT_PROBE_LINEAR || is_prime(probed->capacity));
+        for (int i = 0; i < 2000; i++) {
+            assert(hashtable_put(probed, &i, &i)); // grows through several resizes
+        }
+        for (int i = 0; i < 2000; i += 2) {
+            hashtable_remove(probed, &i);
+        }
+        // switching a populated table rebuilds it along the new sequence
+        HTProbeStrategy next = strategies[(s + 1) % (sizeof(strategies) / sizeof(strategies[0]))];
+        assert(hashtable_set_probe(probed, next) && probed->probe == next);
+        assert(hashtable_count(probed) == 1000);
+        for (int i = 0; i < 2000; i++) {
+            int *out_find = (int *)hashtable_find(probed, &i);
+            assert(i % 2 == 0 ? out_find == NULL : (out_find != NULL && *out_find == i));
+            assert((hashtable_probe_length(probed, &i) > 0) == (i % 2 == 1));
+        }
+        assert(!hashtable_set_probe(probed, (HTProbeStrategy)7) && probed->probe == next);
+        hashtable_destroy(probed);
+    }
+
+    Hashtable *double_scanned = hashtable_create(int, int, 10);
+    assert(hashtable_set_probe(double_scanned, HT_PROBE_DOUBLE));
+    for (int i = 0; i < 500; i++) {
+        assert(hashtable_put(double_scanned, &i, &i));
+    }
+    int double_visits[500] = {0};
+    assert(hashtable_scan(double_scanned, 0, 64, mark_scanned, double_visits) == 0); // unsupported, nothing visited
+    for (int i = 0; i < 500; i++) {
+        assert(double_visits[i] == 0);
+    }
+    hashtable_destroy(double_scanned);
+
+    Hashtable *double_multi = hashtable_create_multimap(int, int, 10);
+    assert(hashtable_set_probe(double_multi, HT_PROBE_DOUBLE));
+    for (int dup = 0; dup < 3; dup++) {
+        for (int i = 0; i < 200; i++) {
+            int value = i * 10 + dup;
+            assert(hashtable_put(double_multi, &i, &value));
+        }
+    }
+    range_cnt = 0;
+    for (const Hashentry *entry = HTEqualRange_start(&range, double_multi, &multi_key); entry; entry = HTEqualRange_next(&range)) {
+        assert(*(int *)entry->key == 7);
+        range_cnt++;
+    }
+    assert(range_cnt == 3);
+    assert(hashtable_remove_all(double_multi, &multi_key) == 3 && hashtable_count(double_multi) == 597);
+    hashtable_destroy(double_multi);
+    printf("Passed tests for linear, quadratic and double hashing probe strategies\n");
+
+
+    Hashtable *exported = hashtable_create(int, int, 16);
+    for (int i = 0; i < 3; i++) {
+        assert(hashtable_put(exported, &i, &i));
+    }
+    char export_buf[8192];
+    size_t export_len = hashtable_stats_json(exported, export_buf, sizeof(export_buf));
+    assert(export_len == strlen(export_buf));
+    assert(strncmp(export_buf, "{\"count\":3,\"capacity\":", 21) == 0);
+    assert(strstr(export_buf, "\"memory\":{\"total_bytes\":") != NULL);
+    // measured in hashtable_export.c, a separate translation unit under HASHTABLE_INLINE_ALL
+    assert(strstr(export_buf, "\"malloc_overhead_bytes\":0,") == NULL);
+    char small_buf[8];
+    assert(hashtable_stats_json(exported, small_buf, sizeof(small_buf)) == export_len); // truncated, full length reported
+    assert(strlen(small_buf) == sizeof(small_buf) - 1);
+    assert(hashtable_stats_json(exported, NULL, 0) == export_len);
+    export_len = hashtable_stats_prometheus(exported, "sessions", export_buf, sizeof(export_buf));
+    assert(export_len < sizeof(export_buf));
+    assert(strstr(export_buf, "# TYPE hashtable_entries gauge\nhashtable_entries{table=\"sessions\"} 3\n") != NULL);
+
+    Hashtable *exported_other = hashtable_create(int, int, 16);
+    assert(hashtable_registry_add("sessions", exported));
+    assert(hashtable_registry_add("quo\"ted", exported_other));
+    assert(hashtable_registry_add("users", exported)); // re-adding renames
+    assert(hashtable_registry_count() == 2);
+    export_len = hashtable_registry_json(export_buf, sizeof(export_buf));
+    assert(export_len < sizeof(export_buf));
+    assert(strncmp(export_buf, "{\"tables\":[{\"name\":\"users\",\"count\":3,", 37) == 0);
+    assert(strstr(export_buf, "{\"name\":\"quo\\\"ted\",\"count\":0,") != NULL);
+    export_len = hashtable_registry_prometheus(export_buf, sizeof(export_buf));
+    assert(export_len < sizeof(export_buf));
+    assert(strstr(export_buf, "hashtable_capacity{table=\"users\"}") != NULL);
+    assert(strstr(export_buf, "hashtable_capacity{table=\"quo\\\"ted\"}") != NULL);
+#ifdef HASHTABLE_STATS
+    assert(strstr(export_buf, "hashtable_probe_length_bucket{table=\"users\",le=\"+Inf\"} 3\n") != NULL);
+#endif
+    assert(hashtable_registry_remove(exported) && hashtable_registry_remove(exported_other));
+    assert(!hashtable_registry_remove(exported));
+    assert(hashtable_registry_count() == 0);
+
+    // the label escaper only emits what the exposition format allows
+    assert(hashtable_registry_add("tab\tbed", exported));
+    hashtable_registry_prometheus(export_buf, sizeof(export_buf));
+    assert(strstr(export_buf, "hashtable_entries{table=\"tabbed\"} 3\n") != NULL);
+    hashtable_registry_json(export_buf, sizeof(export_buf));
+    assert(strstr(export_buf, "\"name\":\"tab\\u0009bed\"") != NULL);
+    assert(hashtable_registry_remove(exported));
+
+    // a table owned by another thread is scraped under its lock while it grows
+    ScrapedTable scraped = {PTHREAD_MUTEX_INITIALIZER, NULL, 0};
+    scraped.table = hashtable_create(int, int, 8);
+    assert(hashtable_registry_add_locked("live", scraped.table, scraped_lock, scraped_unlock, &scraped));
+    assert(!hashtable_registry_add_locked("half", exported, scraped_lock, NULL, &scraped));
+    pthread_t writer;
+    assert(pthread_create(&writer, NULL, scraped_writer, &scraped) == 0);
+    int scrapes = 0;
+    for (; scrapes < 200; scrapes++) {
+        assert(hashtable_registry_prometheus(export_buf, sizeof(export_buf)) < sizeof(export_buf));
+    }
+    pthread_join(writer, NULL);
+    assert(scraped.locks == scrapes);
+    hashtable_registry_json(export_buf, sizeof(export_buf));
+    assert(strstr(export_buf, "{\"name\":\"live\",\"count\":20000,") != NULL);
+    assert(hashtable_registry_remove(scraped.table));
+    hashtable_destroy(scraped.table);
+    hashtable_destroy(exported);
+    hashtable_destroy(exported_other);
+    printf("Passed tests for JSON/Prometheus stats export and the table registry\n");
+
+
+    HTNumaTable numa;
+    assert(hashtable_numa_node_count() >= 1);
+    assert(hashtable_numa_init(&numa, sizeof(int), sizeof(int), 20000, 2, 2)); // 2 emulated nodes
+    assert(numa.shard_count == 4);
+    NumaWorker workers[2] = {{&numa, 0, 10000}, {&numa, 1, 10000}};
+    pthread_t worker_threads[2];
+    for (int i = 0; i < 2; i++) {
+        assert(pthread_create(&worker_threads[i], NULL, numa_worker, &workers[i]) == 0);
+    }
+    for (int i = 0; i < 2; i++) {
+        pthread_join(worker_threads[i], NULL);
+    }
+    assert(hashtable_numa_count(&numa) == 10000);
+    HTNumaStats numa_stats = hashtable_numa_stats(&numa);
+    assert(numa_stats.local == 10000 && numa_stats.remote == 0);
+    HTNumaStats node_stats = hashtable_numa_node_stats(&numa, 1);
+    assert(node_stats.local > 0 && node_stats.local < 10000);
+
+    hashtable_numa_reset_stats(&numa);
+    hashtable_numa_set_thread_node(0);
+    for (int i = 0; i < 10000; i++) {
+        int value;
+        assert(hashtable_numa_get(&numa, &i, &value) && value == i * 7);
+    }
+    numa_stats = hashtable_numa_stats(&numa);
+    assert(numa_stats.local == 10000 - node_stats.local && numa_stats.remote == node_stats.local);
+    for (int i = 0; i < 10000; i += 2) {
+        assert(hashtable_numa_remove(&numa, &i));
+    }
+    int absent = 0;
+    assert(!hashtable_numa_remove(&numa, &absent) && !hashtable_numa_contains(&numa, &absent));
+    assert(hashtable_numa_count(&numa) == 5000);
+    hashtable_numa_deinit(&numa);
+    printf("Passed tests for the NUMA sharded table\n");
+
+
+#ifdef HASHTABLE_HUGEPAGES
+    const uintptr_t huge_page = 2 * 1024 * 1024;
+    Hashtable huge;
+    unsigned int small_cap = HT_HUGEPAGE_MIN_BYTES / sizeof(Hashentry) / 2;
+    assert(hashtable_init(&huge, sizeof(int), sizeof(int), small_cap));
+    assert(huge.capacity * sizeof(Hashentry) < HT_HUGEPAGE_MIN_BYTES); // below the threshold, plain malloc
+    for (int i = 0; i < (int)small_cap; i++) { // grows past the threshold
+        assert(hashtable_put(&huge, &i, &i));
+    }
+    assert(huge.capacity * sizeof(Hashentry) >= HT_HUGEPAGE_MIN_BYTES);
+    assert((uintptr_t)huge.arr % huge_page == 0);
+    for (int i = 0; i < (int)small_cap; i++) {
+        assert(*(int *)hashtable_find(&huge, &i) == i);
+    }
+    hashtable_deinit(&huge);
+
+    inttable huge_typed;
+    assert(inttable_init(&huge_typed, HT_HUGEPAGE_MIN_BYTES / sizeof(inttable_entry) + 1));
+    assert((uintptr_t)huge_typed.arr % huge_page == 0);
+    for (int i = 0; i < 1000; i++) {
+        assert(inttable_put(&huge_typed, i, -i));
+    }
+    assert(*inttable_find(&huge_typed, 999) == -999);
+    inttable_deinit(&huge_typed);
+    printf("Passed tests for huge page entry arrays\n");
+#endif
+
+
+#ifdef HASHTABLE_TRACE
+    const char *trace_path = "hashtable_tests_trace.bin";
+    Hashtable *traced = hashtable_create(int, int, 8);
+    assert(hashtable_trace_start(traced, trace_path, false));
+    for (int i = 0; i < 3; i++) {
+        assert(hashtable_put(traced, &i, &i));
+    }
+    int traced_key = 1;
+    hashtable_find(traced, &traced_key);
+    hashtable_remove(traced, &traced_key);
+    assert(!hashtable_contains(traced, &traced_key));
+    HTIterator traced_itr;
+    int erased_key = *(const int *)HTIterator_start(&traced_itr, traced)->key;
+    assert(HTIterator_erase(&traced_itr));
+    hashtable_resize(traced, 300);
+    hashtable_clear(traced);
+    hashtable_trace_stop(traced);
+    hashtable_put(traced, &traced_key, &traced_key); // not traced anymore
+    hashtable_destroy(traced);
+
+    FILE *trace_file = fopen(trace_path, "rb");
+    assert(trace_file);
+    unsigned char trace_buf[256];
+    size_t trace_len = fread(trace_buf, 1, sizeof(trace_buf), trace_file);
+    fclose(trace_file);
+    remove(trace_path);
+    assert(memcmp(trace_buf, HT_TRACE_MAGIC, 8) == 0);
+    assert(trace_buf[8] == sizeof(int) && trace_buf[12] == sizeof(int) && trace_buf[16] == 0 && trace_buf[20] == 8);
+    // walk the records: op byte, varint time delta, then the key or resize capacity
+    unsigned char expected_ops[] = {HT_TRACE_PUT, HT_TRACE_PUT, HT_TRACE_PUT, HT_TRACE_FIND, HT_TRACE_REMOVE, HT_TRACE_FIND,
+                                    HT_TRACE_REMOVE, HT_TRACE_RESIZE, HT_TRACE_CLEAR};
+    int expected_keys[] = {0, 1, 2, traced_key, traced_key, traced_key, erased_key};
+    size_t trace_pos = 24;
+    for (unsigned int r = 0; r < sizeof(expected_ops); r++) {
+        assert(trace_pos < trace_len && trace_buf[trace_pos++] == expected_ops[r]);
+        while (trace_buf[trace_pos++] & 0x80);
+        if (expected_ops[r] == HT_TRACE_RESIZE) {
+            assert(trace_buf[trace_pos] == ((300 & 0x7F) | 0x80) && trace_buf[trace_pos + 1] == (300 >> 7));
+            trace_pos += 2;
+        } else if (expected_ops[r] != HT_TRACE_CLEAR) {
+            int recorded_key;
+            memcpy(&recorded_key, trace_buf + trace_pos, sizeof(int));
+            assert(recorded_key == expected_keys[r]);
+            trace_pos += sizeof(int);
+        }
+    }
+    assert(trace_pos == trace_len);
+    printf("Passed tests for HASHTABLE_TRACE recording\n");
+#endif
+
+#ifdef HASHTABLE_LATENCY
+    Hashtable *timed = hashtable_create(int, int, 8);
+    for (int i = 0; i < 1000; i++) {
+        assert(hashtable_put(timed, &i, &i));
+    }
+    for (int i = 0; i < 2000; i++) {
+        hashtable_find(timed, &i);
+    }
+    for (int i = 0; i < 500; i++) {
+        hashtable_remove(timed, &i);
+    }
+    HTLatencySummary put_latency = hashtable_latency_summary(timed, HT_LATENCY_PUT);
+    assert(put_latency.count == 1000);
+    assert(put_latency.p50 <= put_latency.p99 && put_latency.p99 <= put_latency.p999);
+    assert(put_latency.p999 <= put_latency.max && put_latency.mean <= put_latency.max);
+    assert(hashtable_latency_summary(timed, HT_LATENCY_FIND).count == 2000);
+    assert(hashtable_latency_summary(timed, HT_LATENCY_REMOVE).count == 500);
+    HTLatencySummary resize_latency = hashtable_latency_summary(timed, HT_LATENCY_RESIZE);
+    assert(resize_latency.count >= 7); // 8 -> 1000 entries doubles at least 7 times
+    assert(hashtable_latency_percentile(timed, HT_LATENCY_PUT, 1.0) == put_latency.max);
+    assert(put_latency.max >= resize_latency.max); // the put that triggered the largest resize includes it
+    assert(hashtable_latency_ticks_per_ns() > 0.0);
+    hashtable_latency_reset(timed);
+    assert(hashtable_latency_summary(timed, HT_LATENCY_FIND).count == 0);
+    assert(hashtable_latency_percentile(timed, HT_LATENCY_FIND, 0.5) == 0);
+    hashtable_destroy(timed);
+    printf("Passed tests for HASHTABLE_LATENCY histograms\n");
+#endif
+#ifdef HASHTABLE_STATS
+    Hashtable *counted = hashtable_create(int, int, 8);
+    for (int i = 0; i < 100; i++) {
+        assert(hashtable_put(counted, &i, &i));
+    }
+    for (int i = 0; i < 150; i++) {
+        hashtable_find(counted, &i);
+    }
+    for (int i = 0; i < 10; i++) {
+        hashtable_remove(counted, &i);
+    }
+    HTStats stats;
+    hashtable_get_stats(counted, &stats);
+    assert(stats.puts == 100);
+    assert(stats.finds == 160 && stats.hits == 110 && stats.misses == 50);
+    assert(stats.removes == 10);
+    assert(stats.resizes >= 1);
+    uint64_t probes = 0;
+    for (unsigned int i = 0; i < HT_STATS_PROBE_BUCKETS; i++) {
+        probes += stats.probe_hist[i];
+    }
+    assert(probes == stats.puts + stats.finds);
+    assert(stats.probe_total >= probes && stats.probe_max >= 1);
+    int removed_key = 0;
+    assert(hashtable_find(counted, &removed_key) == NULL);
+    hashtable_get_stats(counted, &stats);
+    assert(stats.tombstones_seen >= 1); // the key's own tombstone sits on its probe sequence
+    hashtable_stats(counted, "stats:");
+    hashtable_reset_stats(counted);
+    hashtable_get_stats(counted, &stats);
+    assert(stats.finds == 0 && stats.probe_total == 0);
+    hashtable_destroy(counted);
+    printf("Passed tests for HASHTABLE_STATS counters\n");
+#endif
+
+
     printf("All Hashtable tests/asserts passed\n");
     return 0;
 }
@@ -0,0 +1,285 @@
+#include <limits.h>
+
+#include "ordered_hashtable.h"
+
+#define XXH_INLINE_ALL
+#include "xxhash/xxhash.h"
+
+// normalized sparse index values, the stored form is all ones / all ones - 1 of the slot width
+#define ORDERED_IX_EMPTY SIZE_MAX
+#define ORDERED_IX_DUMMY (SIZE_MAX - 1) // tombstone in the sparse index
+
+static inline uint64_t ordered_hash(const void *key, size_t key_size) {
+    uint64_t hash = XXH64(key, key_size, 0);
+    // ORDERED_RECORD_DELETED is reserved to mark holes in the dense records
+    return hash == ORDERED_RECORD_DELETED ? hash - 1 : hash;
+}
+
+// smallest slot width whose two reserved values stay clear of every record number
+static unsigned int ordered_index_width(unsigned int dense_cap) {
+    if (dense_cap < UINT8_MAX - 1) return 1;
+    if (dense_cap < UINT16_MAX - 1) return 2;
+    return 4;
+}
+
+static inline size_t ordered_index_get(const OrderedHashtable *oht, unsigned int slot) {
+    size_t ix, empty;
+    switch (oht->index_width) {
+    case 1: ix = ((const uint8_t *)oht->index)[slot]; empty = UINT8_MAX; break;
+    case 2: ix = ((const uint16_t *)oht->index)[slot]; empty = UINT16_MAX; break;
+    default: ix = ((const uint32_t *)oht->index)[slot]; empty = UINT32_MAX; break;
+    }
+    if (ix == empty) return ORDERED_IX_EMPTY;
+    if (ix == empty - 1) return ORDERED_IX_DUMMY;
+    return ix;
+}
+
+static inline void ordered_index_set(OrderedHashtable *oht, unsigned int slot, size_t ix) {
+    // the sentinels truncate to all ones / all ones - 1 of the slot width
+    switch (oht->index_width) {
+    case 1: ((uint8_t *)oht->index)[slot] = (uint8_t)ix; break;
+    case 2: ((uint16_t *)oht->index)[slot] = (uint16_t)ix; break;
+    default: ((uint32_t *)oht->index)[slot] = (uint32_t)ix; break;
+    }
+}
+
+static inline unsigned char *ordered_record(const OrderedHashtable *oht, size_t ix) {
+    return oht->records + ix * oht->record_size;
+}
+
+static inline uint64_t *ordered_record_hash(const OrderedHashtable *oht, size_t ix) {
+    return (uint64_t *)ordered_record(oht, ix);
+}
+
+static inline void *ordered_record_key(const OrderedHashtable *oht, size_t ix) {
+    return ordered_record(oht, ix) + sizeof(uint64_t);
+}
+
+static inline void *ordered_record_value(const OrderedHashtable *oht, size_t ix) {
+    return ordered_record(oht, ix) + oht->value_offset;
+}
+
+// allocates an empty index/record array pair for desired_capacity, the old arrays are left untouched
+static bool ordered_hashtable_alloc(OrderedHashtable *oht, unsigned int desired_capacity) {
+    ht_index_t prime = hashtable_probe_capacity(desired_capacity);
+    if (prime == 0 || prime > UINT_MAX) { // the sparse index holds at most 32 bit record numbers
+        fprintf(stderr, "OrderedHashtable capacity limit reached\n");
+        return false;
+    }
+    unsigned int capacity = (unsigned int)prime;
+    unsigned int dense_cap = (unsigned int)(capacity * TARGET_LOAD_FACTOR);
+    if (dense_cap < 1) {
+        dense_cap = 1;
+    }
+    unsigned int index_width = ordered_index_width(dense_cap);
+    void *index = malloc((size_t)capacity * index_width);
+    unsigned char *records = (unsigned char *)malloc((size_t)dense_cap * oht->record_size);
+    if (!index || !records) {
+        fprintf(stderr, "Unable to allocate memory for OrderedHashtable index/records\n");
+        free(index);
+        free(records);
+        return false;
+    }
+    memset(index, 0xFF, (size_t)capacity * index_width); // every slot ORDERED_IX_EMPTY
+    oht->capacity = capacity;
+    oht->dense_cap = dense_cap;
+    oht->index_width = index_width;
+    oht->index = index;
+    oht->records = records;
+    return true;
+}
+
+bool ordered_hashtable_init(OrderedHashtable *oht, const size_t key_size, const size_t value_size, const unsigned int base_capacity) {
+    if (!oht) {
+        fprintf(stderr, "OrderedHashtable is NULL, unable to initialize.\n");
+        return false;
+    }
+    if (key_size < 1 || base_capacity < 1) {
+        fprintf(stderr, "To use ordered_hashtable_init both the key_size for the type, and capacity must be positive\n");
+        return false;
+    }
+    oht->key_size = key_size;
+    oht->value_size = value_size;
+    // values are aligned to the largest power of two dividing value_size, capped at 8
+    size_t value_align = 1;
+    while (value_align < 8 && value_size % (value_align * 2) == 0) {
+        value_align *= 2;
+    }
+    oht->value_offset = (sizeof(uint64_t) + key_size + value_align - 1) & ~(value_align - 1);
+    oht->record_size = (oht->value_offset + value_size + 7) & ~(size_t)7;
+    oht->count = 0;
+    oht->dense_len = 0;
+    return ordered_hashtable_alloc(oht, base_capacity);
+}
+
+void ordered_hashtable_deinit(OrderedHashtable *oht) {
+    if (!oht) {
+        return;
+    }
+    free(oht->index);
+    free(oht->records);
+    oht->index = NULL;
+    oht->records = NULL;
+    oht->count = oht->dense_len = 0;
+}
+
+/**
+ * Probes the sparse index for key. Returns the slot holding it with *found set, otherwise the slot a new
+ * record number should go into, preferring the first index tombstone. UINT_MAX when the index is exhausted.
+ */
+static unsigned int ordered_probe(const OrderedHashtable *oht, const void *key, uint64_t key_hash, bool *found) {
+    unsigned int start_idx = home_idx(key_hash, oht->capacity);
+    unsigned int curr_idx = start_idx;
+    unsigned int first_dummy_idx = UINT_MAX;
+    *found = false;
+    for (unsigned int x = 0; x < oht->capacity; curr_idx = probe_idx(start_idx, ++x, oht->capacity)) {
+        size_t ix = ordered_index_get(oht, curr_idx);
+        if (ix == ORDERED_IX_EMPTY) {
+            return first_dummy_idx != UINT_MAX ? first_dummy_idx : curr_idx;
+        }
+        if (ix == ORDERED_IX_DUMMY) {
+            if (first_dummy_idx == UINT_MAX) {
+                first_dummy_idx = curr_idx;
+            }
+        } else if (*ordered_record_hash(oht, ix) == key_hash &&
+                   memcmp(ordered_record_key(oht, ix), key, oht->key_size) == 0) {
+            *found = true;
+            return curr_idx;
+        }
+    }
+    return first_dummy_idx;
+}
+
+bool ordered_hashtable_resize(OrderedHashtable *oht, unsigned int desired_capacity) {
+    if ((float)oht->count / desired_capacity >= TARGET_LOAD_FACTOR) {
+        fprintf(stderr, "The desired capacity passed to ordered_hashtable_resize is too low to contain all current elements\n");
+        return false;
+    }
+    OrderedHashtable old = *oht;
+    if (!ordered_hashtable_alloc(oht, desired_capacity)) {
+        *oht = old;
+        return false;
+    }
+    // copy live records in their original order, holes are dropped
+    oht->dense_len = 0;
+    for (unsigned int ix = 0; ix < old.dense_len; ix++) {
+        uint64_t stored_hash = *ordered_record_hash(&old, ix);
+        if (stored_hash == ORDERED_RECORD_DELETED) {
+            continue;
+        }
+        unsigned int start_idx = home_idx(stored_hash, oht->capacity);
+        unsigned int curr_idx = start_idx;
+        unsigned int x = 0;
+        while (ordered_index_get(oht, curr_idx) != ORDERED_IX_EMPTY && x < oht->capacity) {
+            curr_idx = probe_idx(start_idx, ++x, oht->capacity);
+        }
+        assert(x < oht->capacity);
+        memcpy(ordered_record(oht, oht->dense_len), ordered_record(&old, ix), oht->record_size);
+        ordered_index_set(oht, curr_idx, oht->dense_len++);
+    }
+    free(old.index);
+    free(old.records);
+    return true;
+}
+
+bool ordered_hashtable_put(OrderedHashtable *oht, const void *key, const void *value) {
+    if (!oht || !key || (!value && oht->value_size > 0)) {
+        fprintf(stderr, "ordered_hashtable_put failed, check the table pointer is valid plus key/value usage\n");
+        return false;
+    }
+    uint64_t hash = ordered_hash(key, oht->key_size);
+    bool found;
+    unsigned int slot = ordered_probe(oht, key, hash, &found);
+    if (found) {
+        if (oht->value_size > 0) { // sets have no value to overwrite, value may be NULL
+            memcpy(ordered_record_value(oht, ordered_index_get(oht, slot)), value, oht->value_size);
+        }
+        return true;
+    }
+    if (oht->dense_len == oht->dense_cap || slot == UINT_MAX) {
+        // compact in place when most of the dense array is holes, otherwise grow
+        unsigned int desired = oht->count + 1 > oht->dense_cap / 2 ? 2 * oht->capacity : oht->capacity;
+        if (!ordered_hashtable_resize(oht, desired)) {
+            fprintf(stderr, "ordered_hashtable_put failed due to failed resize\n");
+            return false;
+        }
+        slot = ordered_probe(oht, key, hash, &found);
+        assert(slot != UINT_MAX);
+    }
+    size_t ix = oht->dense_len++;
+    *ordered_record_hash(oht, ix) = hash;
+    memcpy(ordered_record_key(oht, ix), key, oht->key_size);
+    if (oht->value_size > 0) {
+        memcpy(ordered_record_value(oht, ix), value, oht->value_size);
+    }
+    ordered_index_set(oht, slot, ix);
+    oht->count++;
+    return true;
+}
+
+void *ordered_hashtable_find(const OrderedHashtable *oht, const void *key) {
+    if (oht->count == 0) {
+        return NULL;
+    }
+    bool found;
+    unsigned int slot = ordered_probe(oht, key, ordered_hash(key, oht->key_size), &found);
+    if (!found) {
+        return NULL;
+    }
+    size_t ix = ordered_index_get(oht, slot);
+    return oht->value_size > 0 ? ordered_record_value(oht, ix) : ordered_record_key(oht, ix);
+}
+
+bool ordered_hashtable_contains(const OrderedHashtable *oht, const void *key) {
+    return ordered_hashtable_find(oht, key) != NULL;
+}
+
+bool ordered_hashtable_remove(OrderedHashtable *oht, const void *key) {
+    if (oht->count == 0) {
+        return false;
+    }
+    bool found;
+    unsigned int slot = ordered_probe(oht, key, ordered_hash(key, oht->key_size), &found);
+    if (!found) {
+        return false;
+    }
+    *ordered_record_hash(oht, ordered_index_get(oht, slot)) = ORDERED_RECORD_DELETED;
+    ordered_index_set(oht, slot, ORDERED_IX_DUMMY);
+    oht->count--;
+    return true;
+}
+
+void ordered_hashtable_clear(OrderedHashtable *oht) {
+    memset(oht->index, 0xFF, (size_t)oht->capacity * oht->index_width);
+    oht->count = 0;
+    oht->dense_len = 0;
+}
+
+unsigned int ordered_hashtable_count(const OrderedHashtable *oht) {
+    return oht->count;
+}
+
+const OrderedEntry *OHTIterator_start(OHTIterator *iterator, const OrderedHashtable *oht) {
+    if (!iterator || !oht) {
+        fprintf(stderr, "A valid Iterator pointer and table pointer are needed for OHTIterator_start\n");
+        return NULL;
+    }
+    iterator->oht = oht;
+    iterator->curr_record = 0;
+    return OHTIterator_next(iterator);
+}
+
+const OrderedEntry *OHTIterator_next(OHTIterator *iterator) {
+    const OrderedHashtable *oht = iterator->oht;
+    while (iterator->curr_record < oht->dense_len) {
+        size_t ix = iterator->curr_record++;
+        uint64_t stored_hash = *ordered_record_hash(oht, ix);
+        if (stored_hash != ORDERED_RECORD_DELETED) {
+            iterator->entry.key = ordered_record_key(oht, ix);
+            iterator->entry.value = oht->value_size > 0 ? ordered_record_value(oht, ix) : NULL;
+            iterator->entry.stored_hash = stored_hash;
+            return &iterator->entry;
+        }
+    }
+    return NULL;
+}
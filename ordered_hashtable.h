@@ -0,0 +1,74 @@
+#pragma once
+
+#include "hashtable.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Insertion ordered, compact Hashtable layout in the style of CPython's dict.
+ *
+ * Records (stored_hash, key bytes, value bytes) are appended to a dense array in insertion order and
+ * a separate sparse index of 1/2/4 byte record numbers is probed with the same sequence as Hashtable.
+ * Iteration is a linear scan of the dense records, and the sparse index is several times smaller than
+ * an array of Hashentries since each slot only holds a record number.
+ *
+ * Removing a key leaves a hole in the dense array (its stored_hash becomes ORDERED_RECORD_DELETED)
+ * that is compacted away the next time the table is rebuilt, the relative order of live keys is kept.
+ * A value_size of 0 makes it an ordered set.
+ */
+
+// stored_hash of a removed record, live records never hash to this value
+#define ORDERED_RECORD_DELETED UINT64_MAX
+
+typedef struct OrderedHashtable {
+    unsigned int capacity; // slots in the sparse index
+    unsigned int count; // live records
+    unsigned int dense_len; // records appended so far, live plus holes left by removals
+    unsigned int dense_cap; // records that fit before a rebuild is needed, capacity * TARGET_LOAD_FACTOR
+    size_t key_size;
+    size_t value_size;
+    size_t value_offset; // offset of the value inside a record, after stored_hash and the key
+    size_t record_size; // stored_hash + key + value, padded to 8 bytes
+    unsigned int index_width; // bytes per sparse index slot: 1, 2 or 4
+    void *index; // sparse index of record numbers
+    unsigned char *records; // dense insertion ordered records
+} OrderedHashtable;
+
+// key/value pointers into the dense record, returned by the iterator
+typedef struct OrderedEntry {
+    const void *key;
+    void *value;
+    uint64_t stored_hash;
+} OrderedEntry;
+
+typedef struct OHTIterator {
+    unsigned int curr_record;
+    const OrderedHashtable *oht;
+    OrderedEntry entry;
+} OHTIterator;
+
+bool ordered_hashtable_init(OrderedHashtable *oht, const size_t key_size, const size_t value_size, const unsigned int base_capacity);
+void ordered_hashtable_deinit(OrderedHashtable *oht);
+
+// inserts or overwrites, new keys are appended after every key already present
+bool ordered_hashtable_put(OrderedHashtable *oht, const void *key, const void *value);
+// returns a pointer to the stored value, or to the stored key for sets, NULL when not found
+void *ordered_hashtable_find(const OrderedHashtable *oht, const void *key);
+bool ordered_hashtable_contains(const OrderedHashtable *oht, const void *key);
+// returns true when the key was present and removed
+bool ordered_hashtable_remove(OrderedHashtable *oht, const void *key);
+void ordered_hashtable_clear(OrderedHashtable *oht);
+unsigned int ordered_hashtable_count(const OrderedHashtable *oht);
+
+// rebuilds the sparse index with at least desired_capacity slots and compacts the dense records
+bool ordered_hashtable_resize(OrderedHashtable *oht, unsigned int desired_capacity);
+
+// iterates live records in insertion order
+const OrderedEntry *OHTIterator_start(OHTIterator *iterator, const OrderedHashtable *oht);
+const OrderedEntry *OHTIterator_next(OHTIterator *iterator);
+
+#ifdef __cplusplus
+}
+#endif